@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 
-SUBDIRS += src tests examples
+SUBDIRS += src tests examples tools
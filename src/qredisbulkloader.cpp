@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisbulkloader.h"
+
+#include <assert.h>
+#include <QPointer>
+#include <QTcpSocket>
+#include "qredisclient.h"
+
+// commands are encoded until the socket has this much unwritten, or the
+//   window is full
+#define LOADER_WRITE_AHEAD 1048576
+
+namespace QRedis {
+
+// counts the top-level replies in a stream of them, noting which are
+//   errors, without building any values
+class ReplyCounter
+{
+public:
+	QByteArray buf;
+	int pos;
+	QList<qint64> stack; // elements left in each open aggregate
+	QList<bool> attribute; // whether each open aggregate is an attribute
+	qint64 replies;
+	qint64 errors;
+	qint64 firstError; // index of the first error reply, or -1
+	QByteArray lastError;
+	bool errorReply; // the reply being scanned is an error
+
+	ReplyCounter() :
+		pos(0),
+		replies(0),
+		errors(0),
+		firstError(-1),
+		errorReply(false)
+	{
+	}
+
+	// returns false on a protocol error
+	bool feed(const QByteArray &data)
+	{
+		if(pos > 0 && pos >= buf.size() / 2)
+		{
+			buf = buf.mid(pos);
+			pos = 0;
+		}
+
+		buf += data;
+
+		while(pos < buf.size())
+		{
+			int end = buf.indexOf("\r\n", pos);
+			if(end == -1)
+				break;
+
+			char type = buf[pos];
+			bool top = stack.isEmpty();
+			int lineStart = pos + 1;
+			int next = end + 2;
+
+			switch(type)
+			{
+				case '-':
+					if(top)
+					{
+						errorReply = true;
+						lastError = buf.mid(lineStart, end - lineStart);
+					}
+					// fall through
+				case '+':
+				case ':':
+				case '_':
+				case ',':
+				case '#':
+				case '(':
+					pos = next;
+					elementDone();
+					break;
+				case '$':
+				case '!':
+				case '=':
+				{
+					qint64 len = buf.mid(lineStart, end - lineStart).toLongLong();
+					if(len >= 0)
+					{
+						if(buf.size() < next + len + 2)
+							return true; // wait for the rest
+
+						if(type == '!' && top)
+						{
+							errorReply = true;
+							lastError = buf.mid(next, len);
+						}
+
+						next += len + 2;
+					}
+
+					pos = next;
+					elementDone();
+					break;
+				}
+				case '*':
+				case '~':
+				case '>':
+				case '%':
+				case '|':
+				{
+					qint64 count = buf.mid(lineStart, end - lineStart).toLongLong();
+					if(type == '%' || type == '|')
+						count *= 2;
+
+					pos = next;
+					if(count > 0)
+					{
+						stack += count;
+						attribute += (type == '|');
+					}
+					else if(type != '|')
+						elementDone();
+					break;
+				}
+				default:
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+private:
+	void elementDone()
+	{
+		while(!stack.isEmpty())
+		{
+			if(--stack.last() > 0)
+				return;
+
+			stack.removeLast();
+
+			// an attribute annotates the element that follows it, so
+			//   finishing it doesn't count towards its parent
+			if(attribute.takeLast())
+				return;
+		}
+
+		if(errorReply)
+		{
+			if(firstError == -1)
+				firstError = replies;
+
+			++errors;
+			errorReply = false;
+		}
+
+		++replies;
+	}
+};
+
+class BulkLoader::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	BulkLoader *q;
+	Client *client;
+	int window;
+	bool active;
+	QTcpSocket *sock;
+	QIODevice *device;
+	bool inputFinished;
+	BulkRecordSource *source;
+	bool sourceDone;
+	QList<QList<QByteArray> > handshake;
+	ReplyCounter counter;
+	qint64 sent;
+	QByteArray out;
+
+	Private(BulkLoader *_q, Client *_client) :
+		QObject(_q),
+		q(_q),
+		client(_client),
+		window(10000),
+		active(false),
+		sock(0),
+		device(0),
+		inputFinished(false),
+		source(0),
+		sourceDone(false),
+		sent(0)
+	{
+	}
+
+	~Private()
+	{
+		cleanup();
+	}
+
+	void cleanup()
+	{
+		if(sock)
+		{
+			sock->disconnect(this);
+			sock->abort();
+			sock->deleteLater();
+			sock = 0;
+		}
+
+		if(device)
+		{
+			device->disconnect(this);
+			device = 0;
+		}
+
+		source = 0;
+	}
+
+	void start(QIODevice *_device, BulkRecordSource *_source)
+	{
+		assert(!active);
+
+		active = true;
+		device = _device;
+		source = _source;
+		inputFinished = !device || !device->isSequential();
+		sourceDone = false;
+		counter = ReplyCounter();
+		sent = 0;
+
+		if(device && device->isSequential())
+		{
+			connect(device, SIGNAL(readyRead()), SLOT(device_readyRead()));
+			connect(device, SIGNAL(readChannelFinished()), SLOT(device_readChannelFinished()));
+		}
+
+		// the client's setup goes first. its replies are counted like any
+		//   other, and subtracted when reporting
+		handshake = client->handshakeCommands();
+		foreach(const QList<QByteArray> &args, handshake)
+			encode(args);
+		sent = 0;
+
+		sock = new QTcpSocket(this);
+		connect(sock, SIGNAL(connected()), SLOT(sock_connected()));
+		connect(sock, SIGNAL(readyRead()), SLOT(sock_readyRead()));
+		connect(sock, SIGNAL(bytesWritten(qint64)), SLOT(sock_bytesWritten(qint64)));
+		connect(sock, SIGNAL(error(QAbstractSocket::SocketError)), SLOT(sock_error(QAbstractSocket::SocketError)));
+		sock->connectToHost(client->host(), client->port());
+	}
+
+	qint64 replies() const
+	{
+		return counter.replies - handshake.count();
+	}
+
+private:
+	void encode(const QList<QByteArray> &args)
+	{
+		out += '*';
+		out += QByteArray::number(args.count());
+		out += "\r\n";
+		foreach(const QByteArray &arg, args)
+		{
+			out += '$';
+			out += QByteArray::number(arg.size());
+			out += "\r\n";
+			out += arg;
+			out += "\r\n";
+		}
+
+		++sent;
+	}
+
+	// returns false if no record is available right now
+	bool readRecord(QList<QByteArray> *args)
+	{
+		if(source)
+		{
+			if(sourceDone || !source->nextRecord(args))
+			{
+				sourceDone = true;
+				return false;
+			}
+
+			return true;
+		}
+
+		while(true)
+		{
+			QByteArray line;
+			if(device->canReadLine())
+				line = device->readLine();
+			else if(inputFinished && !device->atEnd())
+				line = device->readAll(); // last line without a newline
+			else
+				return false;
+
+			if(line.endsWith('\n'))
+				line.chop(1);
+			if(line.endsWith('\r'))
+				line.chop(1);
+
+			if(line.isEmpty())
+				continue;
+
+			*args = line.split('\t');
+			return true;
+		}
+	}
+
+	bool inputDone() const
+	{
+		if(source)
+			return sourceDone;
+		else
+			return inputFinished && device->atEnd();
+	}
+
+	void fill()
+	{
+		if(!active || sock->state() != QAbstractSocket::ConnectedState)
+			return;
+
+		QList<QByteArray> args;
+		while(sent - replies() < window && sock->bytesToWrite() + out.size() < LOADER_WRITE_AHEAD)
+		{
+			if(!readRecord(&args))
+				break;
+
+			encode(args);
+		}
+
+		if(!out.isEmpty())
+		{
+			sock->write(out);
+			out.clear();
+		}
+
+		checkFinished();
+	}
+
+	void checkFinished()
+	{
+		if(inputDone() && replies() == sent)
+		{
+			active = false;
+			cleanup();
+			emit q->finished();
+		}
+	}
+
+	void fail()
+	{
+		active = false;
+		cleanup();
+		emit q->error();
+	}
+
+private slots:
+	void sock_connected()
+	{
+		fill();
+	}
+
+	void sock_readyRead()
+	{
+		qint64 before = counter.replies;
+
+		// a failed setup command would make everything after it fail
+		if(!counter.feed(sock->readAll()) || (counter.firstError != -1 && counter.firstError < handshake.count()))
+		{
+			fail();
+			return;
+		}
+
+		if(counter.replies == before)
+			return;
+
+		QPointer<QObject> self = this;
+		emit q->progress(replies());
+		if(!self || !active)
+			return;
+
+		fill();
+	}
+
+	void sock_bytesWritten(qint64 bytes)
+	{
+		Q_UNUSED(bytes);
+
+		fill();
+	}
+
+	void sock_error(QAbstractSocket::SocketError e)
+	{
+		Q_UNUSED(e);
+
+		fail();
+	}
+
+	void device_readyRead()
+	{
+		fill();
+	}
+
+	void device_readChannelFinished()
+	{
+		inputFinished = true;
+		fill();
+	}
+};
+
+BulkLoader::BulkLoader(Client *client, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, client);
+}
+
+BulkLoader::~BulkLoader()
+{
+	delete d;
+}
+
+void BulkLoader::setWindow(int commands)
+{
+	assert(commands > 0);
+
+	d->window = commands;
+}
+
+void BulkLoader::start(QIODevice *device)
+{
+	d->start(device, 0);
+}
+
+void BulkLoader::start(BulkRecordSource *source)
+{
+	d->start(0, source);
+}
+
+qint64 BulkLoader::sentCount() const
+{
+	return d->sent;
+}
+
+qint64 BulkLoader::replyCount() const
+{
+	return d->replies();
+}
+
+qint64 BulkLoader::errorCount() const
+{
+	return d->counter.errors;
+}
+
+QByteArray BulkLoader::lastError() const
+{
+	return d->counter.lastError;
+}
+
+}
+
+#include "qredisbulkloader.moc"
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISBULKLOADER_H
+#define QREDISBULKLOADER_H
+
+#include <QObject>
+
+class QIODevice;
+
+namespace QRedis {
+
+class Client;
+
+// supplies records to a BulkLoader
+class BulkRecordSource
+{
+public:
+	virtual ~BulkRecordSource() {}
+
+	// returns false when there are no more records
+	virtual bool nextRecord(QList<QByteArray> *args) = 0;
+};
+
+// mass insertion. records are encoded straight into the wire protocol and
+//   streamed over a connection of the loader's own, with a window of
+//   commands awaiting replies. replies are only scanned for errors, never
+//   parsed into values, so throughput approaches redis-cli --pipe
+class BulkLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	// connects to the client's server, with the client's auth, database
+	//   and name settings
+	BulkLoader(Client *client, QObject *parent = 0);
+	~BulkLoader();
+
+	// commands sent but not yet answered. default 10000
+	void setWindow(int commands);
+
+	// each line of the device is one command, with arguments separated by
+	//   tabs. sequential devices are read as data arrives, until
+	//   readChannelFinished()
+	void start(QIODevice *device);
+
+	// the source is not owned
+	void start(BulkRecordSource *source);
+
+	qint64 sentCount() const;
+	qint64 replyCount() const;
+	qint64 errorCount() const;
+
+	// the most recent error reply
+	QByteArray lastError() const;
+
+signals:
+	void progress(qint64 replies);
+
+	// all replies received. error replies don't stop the load, see
+	//   errorCount()
+	void finished();
+
+	// the connection failed
+	void error();
+
+private:
+	Q_DISABLE_COPY(BulkLoader)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
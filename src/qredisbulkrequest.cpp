@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisbulkrequest.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QPointer>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredismultikeyreply.h"
+
+namespace QRedis {
+
+class BulkRequest::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Mode
+	{
+		MultiGet,
+		MultiSet,
+		MultiDel
+	};
+
+	class Chunk
+	{
+	public:
+		int first; // position of the first key
+		int count;
+	};
+
+	BulkRequest *q;
+	Client *client;
+	int chunkSize;
+	int maxInFlight;
+	bool active;
+	Mode mode;
+	QByteArray command;
+	QList<QByteArray> keys;
+	QList<QByteArray> values;
+	int next;
+	int done;
+	QHash<Request*, Chunk> chunks;
+	MultiKeyReply merged;
+
+	Private(BulkRequest *_q) :
+		QObject(_q),
+		q(_q),
+		client(0),
+		chunkSize(1000),
+		maxInFlight(8),
+		active(false),
+		mode(MultiGet),
+		next(0),
+		done(0)
+	{
+	}
+
+	~Private()
+	{
+		cleanup();
+	}
+
+	void cleanup()
+	{
+		QHashIterator<Request*, Chunk> it(chunks);
+		while(it.hasNext())
+		{
+			it.next();
+			delete it.key();
+		}
+
+		chunks.clear();
+	}
+
+	void start(Mode _mode, const QList<QByteArray> &_keys, const QList<QByteArray> &_values = QList<QByteArray>())
+	{
+		assert(!active);
+
+		active = true;
+		mode = _mode;
+		keys = _keys;
+		values = _values;
+		next = 0;
+		done = 0;
+
+		if(mode == MultiGet)
+		{
+			command = "MGET";
+			merged.reset(MultiKeyReply::MultiGet, keys.count());
+		}
+		else if(mode == MultiSet)
+		{
+			command = "MSET";
+			merged.reset(MultiKeyReply::MultiSet, keys.count());
+		}
+		else // MultiDel
+		{
+			command = "DEL";
+			merged.reset(MultiKeyReply::MultiDel, keys.count());
+		}
+
+		if(keys.isEmpty())
+		{
+			QMetaObject::invokeMethod(this, "handleFinished", Qt::QueuedConnection);
+			return;
+		}
+
+		sendChunks();
+	}
+
+private:
+	// chunk arguments are only built as window space opens up, so at most
+	//   maxInFlight chunks worth of arguments exist at a time
+	void sendChunks()
+	{
+		while(chunks.count() < maxInFlight && next < keys.count())
+		{
+			int count = qMin(chunkSize, keys.count() - next);
+
+			QList<QByteArray> args;
+			args.reserve(1 + (mode == MultiSet ? count * 2 : count));
+			args += command;
+			for(int n = next; n < next + count; ++n)
+			{
+				args += keys[n];
+				if(mode == MultiSet)
+					args += values[n];
+			}
+
+			Request *req = client->createRequest();
+			connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+			connect(req, SIGNAL(error()), SLOT(req_error()));
+			// the chunk size may be changed while chunks are out
+			Chunk c;
+			c.first = next;
+			c.count = count;
+			chunks.insert(req, c);
+			req->start(args);
+
+			next += count;
+		}
+	}
+
+private slots:
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+		Chunk c = chunks.take(req);
+		delete req;
+
+		if(!merged.add(reply, c.first, c.count))
+		{
+			handleError();
+			return;
+		}
+
+		// no point writing the rest
+		if(merged.hasError())
+		{
+			cleanup();
+			handleFinished();
+			return;
+		}
+
+		done += c.count;
+
+		sendChunks();
+
+		QPointer<QObject> self = this;
+		emit q->progress(done, keys.count());
+		if(!self)
+			return;
+
+		if(done == keys.count())
+			handleFinished();
+	}
+
+	void req_error()
+	{
+		Request *req = (Request *)sender();
+		chunks.remove(req);
+		delete req;
+
+		handleError();
+	}
+
+	void handleFinished()
+	{
+		active = false;
+
+		Reply r = merged.result();
+
+		keys.clear();
+		values.clear();
+		merged.reset(MultiKeyReply::MultiGet, 0);
+
+		emit q->readyRead(r);
+	}
+
+	void handleError()
+	{
+		cleanup();
+
+		keys.clear();
+		values.clear();
+		merged.reset(MultiKeyReply::MultiGet, 0);
+
+		active = false;
+		emit q->error();
+	}
+};
+
+BulkRequest::BulkRequest(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+BulkRequest::~BulkRequest()
+{
+	delete d;
+}
+
+void BulkRequest::setChunkSize(int size)
+{
+	assert(size > 0);
+
+	d->chunkSize = size;
+}
+
+void BulkRequest::setMaxChunksInFlight(int count)
+{
+	assert(count > 0);
+
+	d->maxInFlight = count;
+}
+
+void BulkRequest::mget(const QList<QByteArray> &keys)
+{
+	d->start(Private::MultiGet, keys);
+}
+
+void BulkRequest::mset(const QList<QPair<QByteArray, QByteArray> > &pairs)
+{
+	QList<QByteArray> keys;
+	QList<QByteArray> values;
+	keys.reserve(pairs.count());
+	values.reserve(pairs.count());
+	for(int n = 0; n < pairs.count(); ++n)
+	{
+		keys += pairs[n].first;
+		values += pairs[n].second;
+	}
+
+	d->start(Private::MultiSet, keys, values);
+}
+
+void BulkRequest::del(const QList<QByteArray> &keys)
+{
+	d->start(Private::MultiDel, keys);
+}
+
+void BulkRequest::setup(Client *client)
+{
+	d->client = client;
+}
+
+}
+
+#include "qredisbulkrequest.moc"
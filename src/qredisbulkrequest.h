@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISBULKREQUEST_H
+#define QREDISBULKREQUEST_H
+
+#include <QObject>
+#include <QPair>
+
+namespace QRedis {
+
+class Client;
+class Reply;
+
+// splits huge multi-key commands into chunks and pipelines them, keeping a
+//   limited number of chunks outstanding. the chunk replies are combined
+//   into a single reply, in the original key order. if a chunk gets an
+//   error reply, no more chunks are sent and that reply is the reply
+class BulkRequest : public QObject
+{
+	Q_OBJECT
+
+public:
+	~BulkRequest();
+
+	// keys per command. default 1000
+	void setChunkSize(int size);
+
+	// number of chunks sent but not yet answered. default 8
+	void setMaxChunksInFlight(int count);
+
+	// replies with the values in the order of keys
+	void mget(const QList<QByteArray> &keys);
+
+	// replies with OK
+	void mset(const QList<QPair<QByteArray, QByteArray> > &pairs);
+
+	// replies with the number of keys removed
+	void del(const QList<QByteArray> &keys);
+
+signals:
+	void progress(int done, int total);
+	void readyRead(const QRedis::Reply &reply);
+	void error();
+
+private:
+	Q_DISABLE_COPY(BulkRequest)
+
+	friend class Client;
+	BulkRequest(QObject *parent = 0);
+	void setup(Client *client);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
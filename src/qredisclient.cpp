@@ -25,24 +25,33 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
 #include <QHash>
+#include <QSet>
+#include <QVariant>
+#include <QtEndian>
 #include <QTime>
 #include <QElapsedTimer>
 #include <QTimer>
-#include <QMutex>
-#include "redisqtadapter.h"
+#include "qrediscommands.h"
+#include "qredisconnection.h"
 #include "qredisrequest.h"
+#include "qredisbulkrequest.h"
+#include "qredisdevicerequest.h"
+#include "qredistransaction.h"
+#include "qredisrecorder.h"
+#include "qredisreplybuilder.h"
 
-namespace QRedis {
+// retry tokens saved up are capped at what this many requests earn
+#define RETRY_BUDGET_WINDOW 1000
 
-class GlobalContext
-{
-public:
-	QMutex m;
-	QHash<const redisAsyncContext*, void*> contextMap;
-};
+// encoded values begin with a magic, the codec id (0 for a value stored
+//   as is) and the decoded size as a 32-bit big endian integer
+#define CODEC_MAGIC "\0QZ"
+#define CODEC_MAGIC_SIZE 3
+#define CODEC_HEADER_SIZE 8
 
-Q_GLOBAL_STATIC(GlobalContext, g_context)
+namespace QRedis {
 
 class Client::Private : public QObject
 {
@@ -53,200 +62,390 @@ public:
 	QString host;
 	int port;
 	bool active;
-	RedisQtAdapter *adapter;
-	redisAsyncContext *ac;
-	redisAsyncContext *oldAc;
-	QTimer *reconnectTimer;
+	bool tearingDown;
+	bool lanesEnabled;
+	Connection *primary;
+	Connection *lanes[3]; // indexed by Request::Priority
+	int maxLeases;
+	int leased;
+	QList<Connection*> idleLeases;
+	QList<LeaseWaiter*> leaseWaiters;
 	QElapsedTimer time;
+	bool singleFlight;
+	qint64 collapsed;
+	QHash<QByteArray, Request*> flights;
+	QByteArray user;
+	QByteArray password;
+	int database;
+	QByteArray clientName;
+	int protocolVersion;
+	double retryRatio;
+	int retryMinPerSecond;
+	int maxRetries;
+	double retryTokens;
+	qint64 retrySecond;
+	int retriesThisSecond;
+	qint64 retried;
+	qint64 unsent;
+	QHash<Connection*, QList<Request*> > replays;
+	Codec *codec;
+	bool codecShared;
+	int codecThreshold;
+	QSet<QByteArray> codecCommands;
+	CodecStats codecStats;
+	Recorder *recorder;
+	KeySampler *sampler;
+	QTimer *keyReportTimer;
 
 	Private(Client *_q) :
 		QObject(_q),
 		q(_q),
+		port(0),
 		active(false),
-		adapter(0),
-		ac(0),
-		oldAc(0)
+		tearingDown(false),
+		lanesEnabled(false),
+		maxLeases(8),
+		leased(0),
+		singleFlight(false),
+		collapsed(0),
+		database(0),
+		protocolVersion(0),
+		retryRatio(0.1),
+		retryMinPerSecond(10),
+		maxRetries(2),
+		retryTokens(0),
+		retrySecond(-1),
+		retriesThisSecond(0),
+		retried(0),
+		unsent(0),
+		codec(0),
+		codecShared(false),
+		codecThreshold(1024),
+		recorder(0),
+		sampler(0)
 	{
-		reconnectTimer = new QTimer(this);
-		connect(reconnectTimer, SIGNAL(timeout()), SLOT(reconnect_timeout()));
-		reconnectTimer->setSingleShot(true);
-		reconnectTimer->setInterval(1000);
-	}
+		keyReportTimer = new QTimer(this);
+		connect(keyReportTimer, SIGNAL(timeout()), SLOT(keyReport_timeout()));
+		keyReportTimer->setInterval(10000);
 
-	~Private()
-	{
-		cleanup();
+		primary = new Connection(this);
+
+		// connected first, so replays go out before anything reacting to
+		//   the client's connected() signal
+		connect(primary, SIGNAL(connected()), SLOT(conn_connected()));
+		connect(primary, SIGNAL(connected()), q, SIGNAL(connected()));
+		connect(primary, SIGNAL(disconnected()), q, SIGNAL(disconnected()));
+		connect(primary, SIGNAL(setupFailed(const QByteArray &)), q, SIGNAL(setupFailed(const QByteArray &)));
 
-		reconnectTimer->disconnect(this);
-		reconnectTimer->setParent(0);
-		reconnectTimer->deleteLater();
+		for(int n = 0; n < 3; ++n)
+			lanes[n] = primary;
 	}
 
-	static void contextMapAdd(const redisAsyncContext *ac, Private *cp)
+	void connectToServer(const QString &_host, int _port)
 	{
-		QMutexLocker locker(&(g_context()->m));
-		g_context()->contextMap.insert(ac, cp);
+		assert(!active);
+
+		active = true;
+		host = _host;
+		port = _port;
+
+		time.start();
+
+		primary->setHandshake(handshake());
+		primary->connectToServer(host, port);
+
+		if(lanesEnabled)
+		{
+			// the primary connection serves normal priority
+			lanes[Request::HighPriority] = createConnection();
+			lanes[Request::LowPriority] = createConnection();
+		}
 	}
 
-	static void contextMapRemove(const redisAsyncContext *ac)
+	QList<QList<QByteArray> > handshake() const
 	{
-		QMutexLocker locker(&(g_context()->m));
-		g_context()->contextMap.remove(ac);
+		QList<QList<QByteArray> > out;
+
+		if(protocolVersion != 0)
+		{
+			// one command covers the protocol, credentials and name
+			QList<QByteArray> args;
+			args << "HELLO" << QByteArray::number(protocolVersion);
+			if(!password.isNull())
+				args << "AUTH" << (!user.isNull() ? user : QByteArray("default")) << password;
+			if(!clientName.isNull())
+				args << "SETNAME" << clientName;
+			out += args;
+		}
+		else
+		{
+			if(!password.isNull())
+			{
+				QList<QByteArray> args;
+				args << "AUTH";
+				if(!user.isNull())
+					args << user;
+				args << password;
+				out += args;
+			}
+
+			if(!clientName.isNull())
+				out += QList<QByteArray>() << "CLIENT" << "SETNAME" << clientName;
+		}
+
+		if(database != 0)
+			out += QList<QByteArray>() << "SELECT" << QByteArray::number(database);
+
+		return out;
 	}
 
-	static Private *contextMapGet(const redisAsyncContext *ac)
+	Connection *createConnection()
 	{
-		QMutexLocker locker(&(g_context()->m));
-		return (Private *)g_context()->contextMap.value(ac);
+		Connection *conn = new Connection(this);
+		connect(conn, SIGNAL(connected()), SLOT(conn_connected()));
+		connect(conn, SIGNAL(setupFailed(const QByteArray &)), q, SIGNAL(setupFailed(const QByteArray &)));
+		conn->setHandshake(handshake());
+		conn->setRecorder(recorder);
+		conn->connectToServer(host, port);
+		return conn;
 	}
 
-	void cleanup()
+	Connection *lease(LeaseWaiter *waiter)
 	{
-		if(ac)
+		assert(active);
+
+		if(!idleLeases.isEmpty())
 		{
-			redisAsyncFree(ac);
-			oldAc = ac;
-			ac = 0;
+			++leased;
+			return idleLeases.takeLast();
 		}
 
-		delete adapter;
-		adapter = 0;
-
-		if(oldAc)
+		if(leased < maxLeases)
 		{
-			contextMapRemove(oldAc);
-			oldAc = 0;
+			++leased;
+			return createConnection();
 		}
+
+		leaseWaiters += waiter;
+		return 0;
 	}
 
-	void connectToServer(const QString &_host, int _port)
+	void release(Connection *conn, bool reusable)
 	{
-		assert(!active);
+		// cleanup() deletes every connection itself
+		if(tearingDown)
+			return;
 
-		active = true;
-		host = _host;
-		port = _port;
+		--leased;
 
-		time.start();
+		// a connection whose command was abandoned may still be blocked on
+		//   the server, so it can't be reused
+		if(!reusable)
+		{
+			conn->deleteLater();
+			conn = 0;
+		}
 
-		doConnect();
-	}
+		if(!leaseWaiters.isEmpty())
+		{
+			LeaseWaiter *waiter = leaseWaiters.takeFirst();
+			if(!conn)
+				conn = createConnection();
 
-	void logDebug(const char *fmt, va_list ap)
-	{
-		QString str;
-		str.vsprintf(fmt, ap);
+			++leased;
+			waiter->leaseReady(conn);
+			return;
+		}
 
-		QTime t(0, 0);
-		t = t.addMSecs(time.elapsed());
-		QString tstr = t.toString("HH:mm:ss.zzz");
+		if(!conn)
+			return;
 
-		printf("%s %s\n", qPrintable(tstr), qPrintable(str));
+		// keep a couple of idle connections around, and close the rest
+		if(idleLeases.count() < 2)
+			idleLeases += conn;
+		else
+			conn->deleteLater();
 	}
 
-private:
-	void doConnect()
+	void setRecorder(Recorder *_recorder)
 	{
-		assert(!ac);
+		recorder = _recorder;
 
-		ac = redisAsyncConnect(host.toUtf8(), port);
-		assert(ac);
+		foreach(Connection *conn, findChildren<Connection*>(QString(), Qt::FindDirectChildrenOnly))
+			conn->setRecorder(recorder);
+	}
 
-		contextMapAdd(ac, this);
+	void retryDeposit()
+	{
+		retryTokens = qMin(retryTokens + retryRatio, retryRatio * RETRY_BUDGET_WINDOW);
+	}
 
-		if(ac->err != 0)
+	bool retryWithdraw(int attempts)
+	{
+		if(tearingDown || attempts >= maxRetries)
+			return false;
+
+		qint64 second = time.elapsed() / 1000;
+		if(second != retrySecond)
 		{
-			handleConnect(REDIS_ERR);
-			return;
+			retrySecond = second;
+			retriesThisSecond = 0;
 		}
 
-		adapter = new RedisQtAdapter(this);
-		adapter->setContext(ac);
+		if(retriesThisSecond < retryMinPerSecond)
+			++retriesThisSecond;
+		else if(retryTokens >= 1)
+			retryTokens -= 1;
+		else
+			return false;
+
+		++retried;
+		return true;
+	}
+
+	~Private()
+	{
+		cleanup();
 
-		redisAsyncSetConnectCallback(ac, cb_connected);
-		redisAsyncSetDisconnectCallback(ac, cb_disconnected);
+		if(!codecShared)
+			delete codec;
+		delete sampler;
 	}
 
-	static void cb_connected(const redisAsyncContext *c, int status)
+	void cleanup()
 	{
-		Private *self = contextMapGet(c);
-		assert(self);
+		// freeing a connection fails the commands it holds, and requests
+		//   react to that through the client, so the connections go first
+		//   while everything else is still in place. nothing is replayed
+		//   or handed out again from here on
+		tearingDown = true;
+		leaseWaiters.clear();
+
+		// the primary, the lanes and any leased or idle connections
+		foreach(Connection *conn, findChildren<Connection*>(QString(), Qt::FindDirectChildrenOnly))
+			delete conn;
+
+		primary = 0;
+		for(int n = 0; n < 3; ++n)
+			lanes[n] = 0;
+		idleLeases.clear();
+		replays.clear();
+	}
 
-		self->cb_connected(status);
+	bool codecApplies(const QByteArray &command) const
+	{
+		return codec && (codecCommands.isEmpty() || codecCommands.contains(command.toUpper()));
 	}
 
-	static void cb_disconnected(const redisAsyncContext *c, int status)
+	static bool hasCodecHeader(const QByteArray &value)
 	{
-		Private *self = contextMapGet(c);
-		assert(self);
+		return value.size() >= CODEC_HEADER_SIZE && memcmp(value.constData(), CODEC_MAGIC, CODEC_MAGIC_SIZE) == 0;
+	}
 
-		self->cb_disconnected(status);
+	static QByteArray codecHeader(int id, int size)
+	{
+		QByteArray out(CODEC_HEADER_SIZE, 0);
+		memcpy(out.data(), CODEC_MAGIC, CODEC_MAGIC_SIZE);
+		out[CODEC_MAGIC_SIZE] = (char)id;
+		qToBigEndian<quint32>(size, (uchar *)out.data() + CODEC_MAGIC_SIZE + 1);
+		return out;
 	}
 
-	void cb_connected(int status)
+	QByteArray encodeValue(const QByteArray &value)
 	{
-		if(status == REDIS_ERR)
+		if(value.size() >= codecThreshold)
 		{
-			// hiredis will free ac after this method returns, but we need to remember
-			//   the pointer for cleanup
+			QElapsedTimer t;
+			t.start();
+			QByteArray buf = codec->compress(value);
+			codecStats.encodeNsecs += t.nsecsElapsed();
 
-			// only do the switch if we haven't yet
-			if(ac)
+			if(buf.size() + CODEC_HEADER_SIZE < value.size())
 			{
-				ac->c.fd = -1;
-				oldAc = ac;
-				ac = 0;
+				++codecStats.encoded;
+				codecStats.rawBytes += value.size();
+				codecStats.encodedBytes += buf.size() + CODEC_HEADER_SIZE;
+
+				return codecHeader(codec->id(), value.size()) + buf;
 			}
 		}
 
-		QMetaObject::invokeMethod(this, "handleConnect", Qt::QueuedConnection, Q_ARG(int, status));
+		// a plain value that happens to look encoded is stored with a
+		//   header, so it reads back unchanged
+		if(hasCodecHeader(value))
+			return codecHeader(0, value.size()) + value;
+
+		return value;
 	}
 
-	void cb_disconnected(int status)
+	void decodeValue(QVariant *value)
 	{
-		// if we were explicitly disconnecting, don't react to this callback
-		if(status == REDIS_OK)
+		if(value->type() != QVariant::ByteArray)
 			return;
 
-		// hiredis will free ac after this method returns, but we need to remember
-		//   the pointer for cleanup
+		QByteArray buf = value->toByteArray();
+		if(!hasCodecHeader(buf))
+			return;
 
-		// only do the switch if we haven't yet
-		if(ac)
+		int id = (uchar)buf[CODEC_MAGIC_SIZE];
+		quint32 size = qFromBigEndian<quint32>((const uchar *)buf.constData() + CODEC_MAGIC_SIZE + 1);
+
+		if(id == 0)
 		{
-			oldAc = ac;
-			ac = 0;
+			*value = buf.mid(CODEC_HEADER_SIZE);
+			return;
 		}
 
-		QMetaObject::invokeMethod(this, "handleDisconnect", Qt::QueuedConnection, Q_ARG(int, status));
-	}
+		// written with a different codec. leave it alone
+		if(id != codec->id())
+			return;
 
-private slots:
-	void handleConnect(int status)
-	{
-		if(status == REDIS_ERR)
-		{
-			cleanup();
-			reconnectTimer->start();
+		// the size comes from the server, so don't trust it with an
+		//   allocation the data couldn't fill
+		int encodedSize = buf.size() - CODEC_HEADER_SIZE;
+		if(size > 0x7fffffff || (qint64)size > codec->maxDecodedSize(encodedSize))
 			return;
-		}
 
-		emit q->connected();
+		QElapsedTimer t;
+		t.start();
+		QByteArray out = codec->decompress(buf.mid(CODEC_HEADER_SIZE), (int)size);
+		codecStats.decodeNsecs += t.nsecsElapsed();
+
+		if(out.isNull())
+			return;
+
+		++codecStats.decoded;
+		*value = out;
 	}
 
-	void handleDisconnect(int status)
+	void logDebug(const char *fmt, va_list ap)
 	{
-		cleanup();
+		QString str;
+		str.vsprintf(fmt, ap);
 
-		if(status == REDIS_ERR)
-			reconnectTimer->start();
+		QTime t(0, 0);
+		t = t.addMSecs(time.elapsed());
+		QString tstr = t.toString("HH:mm:ss.zzz");
 
-		emit q->disconnected();
+		printf("%s %s\n", qPrintable(tstr), qPrintable(str));
 	}
 
-	void reconnect_timeout()
+private slots:
+	void conn_connected()
 	{
-		doConnect();
+		Connection *conn = (Connection *)sender();
+
+		QList<Request*> reqs = replays.take(conn);
+		foreach(Request *req, reqs)
+			req->replay();
+	}
+
+	void keyReport_timeout()
+	{
+		emit q->keyStatsReady();
+
+		if(sampler)
+			sampler->decay();
 	}
 };
 
@@ -261,11 +460,51 @@ Client::~Client()
 	delete d;
 }
 
+void Client::setAuth(const QByteArray &password, const QByteArray &user)
+{
+	assert(!d->active);
+
+	d->password = password;
+	d->user = user;
+}
+
+void Client::setDatabase(int index)
+{
+	assert(!d->active);
+
+	d->database = index;
+}
+
+void Client::setClientName(const QByteArray &name)
+{
+	assert(!d->active);
+
+	d->clientName = name;
+}
+
+void Client::setProtocolVersion(int version)
+{
+	assert(!d->active);
+	assert(version == 0 || version == 2 || version == 3);
+
+	d->protocolVersion = version;
+}
+
 void Client::connectToServer(const QString &host, int port)
 {
 	d->connectToServer(host, port);
 }
 
+QString Client::host() const
+{
+	return d->host;
+}
+
+int Client::port() const
+{
+	return d->port;
+}
+
 Request *Client::createRequest()
 {
 	Request *req = new Request;
@@ -273,9 +512,179 @@ Request *Client::createRequest()
 	return req;
 }
 
+BulkRequest *Client::createBulkRequest()
+{
+	BulkRequest *req = new BulkRequest;
+	req->setup(this);
+	return req;
+}
+
+DeviceRequest *Client::createDeviceRequest()
+{
+	DeviceRequest *req = new DeviceRequest;
+	req->setup(this);
+	return req;
+}
+
+Transaction *Client::createTransaction()
+{
+	Transaction *t = new Transaction;
+	t->setup(this);
+	return t;
+}
+
+void Client::setSingleFlightEnabled(bool enabled)
+{
+	d->singleFlight = enabled;
+}
+
+qint64 Client::collapsedCount() const
+{
+	return d->collapsed;
+}
+
+void Client::setPriorityLanesEnabled(bool enabled)
+{
+	assert(!d->active);
+
+	d->lanesEnabled = enabled;
+}
+
+void Client::setMaxBlockingConnections(int count)
+{
+	assert(count > 0);
+
+	d->maxLeases = count;
+}
+
+void Client::setRetryBudget(double ratio, int minPerSecond)
+{
+	assert(ratio >= 0);
+	assert(minPerSecond >= 0);
+
+	d->retryRatio = ratio;
+	d->retryMinPerSecond = minPerSecond;
+	d->retryTokens = qMin(d->retryTokens, ratio * RETRY_BUDGET_WINDOW);
+}
+
+void Client::setMaxRetries(int count)
+{
+	assert(count >= 0);
+
+	d->maxRetries = count;
+}
+
+qint64 Client::retriedCount() const
+{
+	return d->retried;
+}
+
+qint64 Client::unsentCount() const
+{
+	return d->unsent;
+}
+
+void Client::setCodec(Codec *codec, int threshold)
+{
+	assert(threshold >= 0);
+
+	if(!d->codecShared)
+		delete d->codec;
+	d->codec = codec;
+	d->codecShared = false;
+	d->codecThreshold = threshold;
+}
+
+void Client::setCodecCommands(const QList<QByteArray> &names)
+{
+	d->codecCommands.clear();
+	foreach(const QByteArray &name, names)
+	{
+		assert(isCodecCommand(name));
+		d->codecCommands += name.toUpper();
+	}
+}
+
+CodecStats Client::codecStats() const
+{
+	return d->codecStats;
+}
+
+bool Client::startRecording(const QString &fileName)
+{
+	stopRecording();
+
+	Recorder *recorder = new Recorder(d);
+	if(!recorder->open(fileName))
+	{
+		delete recorder;
+		return false;
+	}
+
+	d->setRecorder(recorder);
+	return true;
+}
+
+void Client::stopRecording()
+{
+	Recorder *recorder = d->recorder;
+	d->setRecorder(0);
+	delete recorder;
+}
+
+void Client::setKeySampling(int sampleEvery)
+{
+	assert(sampleEvery >= 0);
+
+	if(sampleEvery > 0)
+	{
+		if(!d->sampler)
+			d->sampler = new KeySampler;
+
+		d->sampler->setSampleEvery(sampleEvery);
+
+		if(!d->keyReportTimer->isActive())
+			d->keyReportTimer->start();
+	}
+	else
+	{
+		delete d->sampler;
+		d->sampler = 0;
+		d->keyReportTimer->stop();
+	}
+}
+
+void Client::setKeyReportInterval(int msecs)
+{
+	assert(msecs > 0);
+
+	d->keyReportTimer->setInterval(msecs);
+}
+
+QList<HotKey> Client::hotKeys() const
+{
+	if(!d->sampler)
+		return QList<HotKey>();
+
+	return d->sampler->hotKeys();
+}
+
+QList<BigKey> Client::bigKeys() const
+{
+	if(!d->sampler)
+		return QList<BigKey>();
+
+	return d->sampler->bigKeys();
+}
+
+void Client::setHostCacheTtl(int msecs)
+{
+	Connection::setHostCacheTtl(msecs);
+}
+
 redisAsyncContext *Client::getContext()
 {
-	return d->ac;
+	return d->primary->context();
 }
 
 void Client::logDebug(const char *fmt, ...)
@@ -286,6 +695,181 @@ void Client::logDebug(const char *fmt, ...)
 	va_end(ap);
 }
 
+Connection *Client::connectionForPriority(int priority) const
+{
+	assert(priority >= 0 && priority < 3);
+
+	return d->lanes[priority];
+}
+
+Connection *Client::leaseConnection(LeaseWaiter *waiter)
+{
+	return d->lease(waiter);
+}
+
+void Client::releaseConnection(Connection *conn, bool reusable)
+{
+	d->release(conn, reusable);
+}
+
+void Client::cancelLease(LeaseWaiter *waiter)
+{
+	d->leaseWaiters.removeAll(waiter);
+}
+
+bool Client::isSingleFlightEnabled() const
+{
+	return d->singleFlight;
+}
+
+Request *Client::flightLeader(const QByteArray &id) const
+{
+	return d->flights.value(id);
+}
+
+void Client::setFlightLeader(const QByteArray &id, Request *req)
+{
+	d->flights.insert(id, req);
+}
+
+void Client::removeFlightLeader(const QByteArray &id, Request *req)
+{
+	if(d->flights.value(id) == req)
+		d->flights.remove(id);
+}
+
+void Client::flightCollapsed()
+{
+	++(d->collapsed);
+}
+
+void Client::retryDeposit()
+{
+	d->retryDeposit();
+}
+
+bool Client::retryWithdraw(int attempts)
+{
+	return d->retryWithdraw(attempts);
+}
+
+void Client::queueReplay(Connection *conn, Request *req)
+{
+	d->replays[conn] += req;
+}
+
+void Client::commandUnsent()
+{
+	++(d->unsent);
+}
+
+void Client::encodeArgs(QList<QByteArray> *args)
+{
+	if(!d->codecApplies(args->first()))
+		return;
+
+	foreach(int n, codecValueArgs(*args))
+		(*args)[n] = d->encodeValue(args->at(n));
+}
+
+void Client::decodeReply(const QList<QByteArray> &args, QVariant *value)
+{
+	if(!d->codecApplies(args[0]))
+		return;
+
+	CodecReplyShape shape = codecReplyShape(args);
+	if(shape == CodecReplyValue)
+	{
+		d->decodeValue(value);
+	}
+	else if(shape == CodecReplyList || shape == CodecReplyPairs)
+	{
+		if(value->type() != QVariant::List)
+			return;
+
+		QVariantList l = value->toList();
+		int step = (shape == CodecReplyPairs ? 2 : 1);
+		for(int n = step - 1; n < l.count(); n += step)
+			d->decodeValue(&l[n]);
+
+		*value = l;
+	}
+}
+
+QList<QList<QByteArray> > Client::handshakeCommands() const
+{
+	return d->handshake();
+}
+
+void Client::copySetup(const Client *source)
+{
+	assert(!d->active);
+
+	d->user = source->d->user;
+	d->password = source->d->password;
+	d->database = source->d->database;
+	d->clientName = source->d->clientName;
+	d->protocolVersion = source->d->protocolVersion;
+}
+
+// the source keeps ownership of the codec, and must outlive this client
+void Client::shareCodec(const Client *source)
+{
+	if(!d->codecShared)
+		delete d->codec;
+	d->codec = source->d->codec;
+	d->codecShared = true;
+	d->codecThreshold = source->d->codecThreshold;
+	d->codecCommands = source->d->codecCommands;
+}
+
+void Client::sampleCommand(const QList<QByteArray> &args)
+{
+	if(!d->sampler || !d->sampler->shouldSample())
+		return;
+
+	foreach(int n, commandKeyArgs(args))
+		d->sampler->addKey(args[n]);
+}
+
+void Client::sampleReply(const QList<QByteArray> &args, const void *reply)
+{
+	if(!d->sampler || replyBuilderIsError(reply))
+		return;
+
+	quint64 size = replyBuilderSize(reply);
+	if(!d->sampler->isBig(size))
+		return;
+
+	QList<int> keys = commandKeyArgs(args);
+	if(keys.isEmpty())
+		return;
+
+	// a reply with one element per key (MGET and the like) is split up
+	//   between the keys
+	if(keys.count() > 1 && replyBuilderElementCount(reply) == keys.count())
+	{
+		for(int n = 0; n < keys.count(); ++n)
+			d->sampler->addReply(args[keys[n]], args[0], replyBuilderSize(replyBuilderElement(reply, n)));
+	}
+	else
+	{
+		d->sampler->addReply(args[keys.first()], args[0], size);
+	}
+}
+
+void Client::cancelReplay(Request *req)
+{
+	QMutableHashIterator<Connection*, QList<Request*> > it(d->replays);
+	while(it.hasNext())
+	{
+		it.next();
+		it.value().removeAll(req);
+		if(it.value().isEmpty())
+			it.remove();
+	}
+}
+
 }
 
 #include "qredisclient.moc"
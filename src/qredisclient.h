@@ -25,6 +25,10 @@
 #define QREDISCLIENT_H
 
 #include <QObject>
+#include "qrediscodec.h"
+#include "qrediskeysampler.h"
+
+class QVariant;
 
 extern "C" {
 struct redisAsyncContext;
@@ -33,6 +37,11 @@ struct redisAsyncContext;
 namespace QRedis {
 
 class Request;
+class BulkRequest;
+class DeviceRequest;
+class Transaction;
+class Connection;
+class LeaseWaiter;
 
 class Client : public QObject
 {
@@ -42,8 +51,108 @@ public:
 	Client(QObject *parent = 0);
 	~Client();
 
+	// connection setup. on every connect and reconnect, the setup commands
+	//   are pipelined ahead of any queued traffic, and connected() is
+	//   emitted only after they succeed. must be set before
+	//   connectToServer()
+	void setAuth(const QByteArray &password, const QByteArray &user = QByteArray());
+	void setDatabase(int index);
+	void setClientName(const QByteArray &name);
+
+	// if set, HELLO is used for the setup, which needs redis 6. version 3
+	//   needs hiredis 1.0 to parse the replies. default 0, meaning the
+	//   server default without HELLO
+	void setProtocolVersion(int version);
+
 	void connectToServer(const QString &host, int port);
+	QString host() const;
+	int port() const;
+
 	Request *createRequest();
+	BulkRequest *createBulkRequest();
+	DeviceRequest *createDeviceRequest();
+	Transaction *createTransaction();
+
+	// if enabled, a read-only command identical to one already in flight
+	//   is not sent. instead it receives the reply of the pending command
+	void setSingleFlightEnabled(bool enabled);
+
+	// number of commands answered by another in-flight command
+	qint64 collapsedCount() const;
+
+	// if enabled, high and low priority requests each get their own
+	//   connection, so they never queue behind each other or behind normal
+	//   traffic. must be set before connectToServer(). the connected() and
+	//   disconnected() signals refer to the normal priority connection
+	void setPriorityLanesEnabled(bool enabled);
+
+	// blocking commands (BLPOP, XREAD with BLOCK, etc) run on
+	//   connections leased from a side pool, so they don't hold up other
+	//   requests. transactions that watch keys lease one as well. the pool
+	//   grows on demand up to this many connections, after which blocking
+	//   commands wait for a connection to be returned.
+	//   WAIT and WAITAOF are not leased, since they wait for the writes
+	//   made on the connection they are sent on. default 8
+	void setMaxBlockingConnections(int count);
+
+	// idempotent commands (by default, the read-only ones) that are cut
+	//   off by a disconnect are sent again right after reconnecting, ahead
+	//   of new traffic, instead of failing. to keep a failing server from
+	//   seeing a retry storm, retries are limited to a ratio of the requests
+	//   started plus a minimum number per second. default 0.1 and 10. zero
+	//   for both disables retries
+	void setRetryBudget(double ratio, int minPerSecond);
+
+	// retries per request. default 2
+	void setMaxRetries(int count);
+
+	// number of commands sent again after a disconnect
+	qint64 retriedCount() const;
+
+	// number of cancelled commands that were dropped before being sent
+	qint64 unsentCount() const;
+
+	// if set, values of the commands that support it (SET, MSET, HSET, GET,
+	//   MGET, HGET, HGETALL and similar) are compressed with the codec when
+	//   they are at least threshold bytes and compression makes them
+	//   smaller. encoded values carry a small header, and are decoded in
+	//   replies transparently. the client takes ownership of the codec
+	void setCodec(Codec *codec, int threshold = 1024);
+
+	// limits the codec to these commands. default empty, meaning all the
+	//   supported ones
+	void setCodecCommands(const QList<QByteArray> &names);
+
+	CodecStats codecStats() const;
+
+	// appends every command written to the server, and the size and
+	//   latency of each reply, to a binary log that qredis-replay can play
+	//   back. the connection setup commands, (P)UNSUBSCRIBE and the raw
+	//   traffic of BulkLoader are not logged. the file is written by a
+	//   thread of its own. returns false if the file can't be created
+	bool startRecording(const QString &fileName);
+	void stopRecording();
+
+	// if non-zero, the keys of one in this many commands sent are counted
+	//   in a sketch that tracks the most used keys. the size of every
+	//   reply, as received, is checked and the largest are kept. default 0
+	void setKeySampling(int sampleEvery);
+
+	// how often keyStatsReady() is emitted while sampling. the counts are
+	//   halved after each report, so keys that cool down drop out. default
+	//   10000
+	void setKeyReportInterval(int msecs);
+
+	// estimated command counts, highest first
+	QList<HotKey> hotKeys() const;
+
+	// the largest replies seen since sampling began, largest first
+	QList<BigKey> bigKeys() const;
+
+	// host names are resolved without blocking the event loop, and the
+	//   addresses are cached for all clients for this long. zero disables
+	//   the cache. default 60000
+	static void setHostCacheTtl(int msecs);
 
 	redisAsyncContext *getContext();
 
@@ -51,11 +160,44 @@ signals:
 	void connected();
 	void disconnected();
 
+	// the server refused a setup command (e.g. wrong credentials). emitted
+	//   for every failed attempt, and the client keeps trying again after
+	//   the reconnect interval
+	void setupFailed(const QByteArray &message);
+	void keyStatsReady();
+
 private:
 	Q_DISABLE_COPY(Client)
 
 	friend class Request;
+	friend class BulkRequest;
+	friend class Transaction;
+	friend class BulkLoader;
+	friend class Subscriber;
+	friend class ShardedClient;
+	friend class ReplicatedClient;
 	void logDebug(const char *fmt, ...);
+	Connection *connectionForPriority(int priority) const;
+	Connection *leaseConnection(LeaseWaiter *waiter);
+	void releaseConnection(Connection *conn, bool reusable);
+	void cancelLease(LeaseWaiter *waiter);
+	bool isSingleFlightEnabled() const;
+	Request *flightLeader(const QByteArray &id) const;
+	void setFlightLeader(const QByteArray &id, Request *req);
+	void removeFlightLeader(const QByteArray &id, Request *req);
+	void flightCollapsed();
+	void retryDeposit();
+	bool retryWithdraw(int attempts);
+	void queueReplay(Connection *conn, Request *req);
+	void cancelReplay(Request *req);
+	void commandUnsent();
+	void encodeArgs(QList<QByteArray> *args);
+	void decodeReply(const QList<QByteArray> &args, QVariant *value);
+	QList<QList<QByteArray> > handshakeCommands() const;
+	void copySetup(const Client *source);
+	void shareCodec(const Client *source);
+	void sampleCommand(const QList<QByteArray> &args);
+	void sampleReply(const QList<QByteArray> &args, const void *reply);
 
 	class Private;
 	friend class Private;
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qrediscodec.h"
+
+#include <string.h>
+#include <QVector>
+
+// LZF limits: back references reach 8192 bytes and copy up to 264 bytes,
+//   and literal runs are up to 32 bytes
+#define LZF_HASH_LOG 14
+#define LZF_MAX_OFF (1 << 13)
+#define LZF_MAX_REF ((1 << 8) + (1 << 3))
+#define LZF_MAX_LIT (1 << 5)
+
+namespace QRedis {
+
+static inline int lzfHash(const uchar *p)
+{
+	quint32 v = (p[0] << 16) | (p[1] << 8) | p[2];
+	return ((v * 2654435761u) >> (32 - LZF_HASH_LOG)) & ((1 << LZF_HASH_LOG) - 1);
+}
+
+int LzfCodec::id() const
+{
+	return 1;
+}
+
+QByteArray LzfCodec::compress(const QByteArray &in) const
+{
+	const uchar *ip = (const uchar *)in.constData();
+	int len = in.size();
+
+	// worst case is all literals, one control byte per run
+	QByteArray out;
+	out.resize(len + len / LZF_MAX_LIT + 1);
+	uchar *op = (uchar *)out.data();
+	int o = 0;
+
+	QVector<int> htab(1 << LZF_HASH_LOG, -1);
+
+	int litStart = 0;
+	int i = 0;
+	while(i + 2 < len)
+	{
+		int h = lzfHash(ip + i);
+		int ref = htab[h];
+		htab[h] = i;
+
+		int off = i - ref - 1;
+		if(ref < 0 || off >= LZF_MAX_OFF || ip[ref] != ip[i] || ip[ref + 1] != ip[i + 1] || ip[ref + 2] != ip[i + 2])
+		{
+			++i;
+			if(i - litStart == LZF_MAX_LIT)
+			{
+				op[o++] = LZF_MAX_LIT - 1;
+				memcpy(op + o, ip + litStart, LZF_MAX_LIT);
+				o += LZF_MAX_LIT;
+				litStart = i;
+			}
+			continue;
+		}
+
+		int maxMatch = qMin(LZF_MAX_REF, len - i);
+		int m = 3;
+		while(m < maxMatch && ip[ref + m] == ip[i + m])
+			++m;
+
+		if(i > litStart)
+		{
+			op[o++] = i - litStart - 1;
+			memcpy(op + o, ip + litStart, i - litStart);
+			o += i - litStart;
+		}
+
+		int l = m - 2;
+		if(l < 7)
+		{
+			op[o++] = (off >> 8) + (l << 5);
+		}
+		else
+		{
+			op[o++] = (off >> 8) + (7 << 5);
+			op[o++] = l - 7;
+		}
+		op[o++] = off & 0xff;
+
+		i += m;
+		litStart = i;
+	}
+
+	// trailing literals
+	while(litStart < len)
+	{
+		int n = qMin(LZF_MAX_LIT, len - litStart);
+		op[o++] = n - 1;
+		memcpy(op + o, ip + litStart, n);
+		o += n;
+		litStart += n;
+	}
+
+	out.resize(o);
+	return out;
+}
+
+QByteArray LzfCodec::decompress(const QByteArray &in, int size) const
+{
+	const uchar *ip = (const uchar *)in.constData();
+	int len = in.size();
+
+	QByteArray out;
+	out.resize(size);
+	uchar *op = (uchar *)out.data();
+	int o = 0;
+
+	int i = 0;
+	while(i < len)
+	{
+		int ctrl = ip[i++];
+
+		if(ctrl < LZF_MAX_LIT)
+		{
+			int n = ctrl + 1;
+			if(i + n > len || o + n > size)
+				return QByteArray();
+
+			memcpy(op + o, ip + i, n);
+			i += n;
+			o += n;
+		}
+		else
+		{
+			int l = ctrl >> 5;
+			if(l == 7)
+			{
+				if(i >= len)
+					return QByteArray();
+				l += ip[i++];
+			}
+			l += 2;
+
+			if(i >= len)
+				return QByteArray();
+			int ref = o - ((ctrl & 0x1f) << 8) - ip[i++] - 1;
+
+			if(ref < 0 || o + l > size)
+				return QByteArray();
+
+			// may overlap, so copy byte by byte
+			for(int n = 0; n < l; ++n)
+				op[o++] = op[ref + n];
+		}
+	}
+
+	if(o != size)
+		return QByteArray();
+
+	return out;
+}
+
+qint64 LzfCodec::maxDecodedSize(int encodedSize) const
+{
+	// the longest back reference takes 3 bytes. rounded up, for a margin
+	return ((qint64)encodedSize / 3 + 1) * LZF_MAX_REF;
+}
+
+}
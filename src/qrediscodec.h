@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISCODEC_H
+#define QREDISCODEC_H
+
+#include <QByteArray>
+
+namespace QRedis {
+
+// transforms values on their way to and from the server. see
+//   Client::setCodec()
+class Codec
+{
+public:
+	virtual ~Codec() {}
+
+	// stored in the header of encoded values, so values written with one
+	//   codec are recognized when read. 1-255
+	virtual int id() const = 0;
+
+	virtual QByteArray compress(const QByteArray &in) const = 0;
+
+	// returns a null array if the input is malformed or doesn't expand
+	//   to the given size
+	virtual QByteArray decompress(const QByteArray &in, int size) const = 0;
+
+	// the most that input of this size can expand to. a stored value
+	//   claiming a larger size is left undecoded, rather than having that
+	//   much memory allocated for it
+	virtual qint64 maxDecodedSize(int encodedSize) const = 0;
+};
+
+// the LZF format. fast, with a modest ratio
+class LzfCodec : public Codec
+{
+public:
+	virtual int id() const;
+	virtual QByteArray compress(const QByteArray &in) const;
+	virtual QByteArray decompress(const QByteArray &in, int size) const;
+	virtual qint64 maxDecodedSize(int encodedSize) const;
+};
+
+class CodecStats
+{
+public:
+	qint64 encoded; // values compressed
+	qint64 decoded; // values decompressed
+	qint64 rawBytes; // size of compressed values before compression
+	qint64 encodedBytes; // size of compressed values after compression
+	qint64 encodeNsecs;
+	qint64 decodeNsecs;
+
+	CodecStats() :
+		encoded(0),
+		decoded(0),
+		rawBytes(0),
+		encodedBytes(0),
+		encodeNsecs(0),
+		decodeNsecs(0)
+	{
+	}
+
+	// raw size over encoded size, or 0 if nothing was compressed yet
+	double ratio() const
+	{
+		return encodedBytes > 0 ? (double)rawBytes / encodedBytes : 0;
+	}
+};
+
+}
+
+#endif
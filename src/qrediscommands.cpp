@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qrediscommands.h"
+
+#include <QSet>
+#include <QHash>
+
+namespace QRedis {
+
+static const char *readOnlyCommands[] =
+{
+	"GET", "MGET", "STRLEN", "GETRANGE", "SUBSTR", "GETBIT", "BITCOUNT", "BITPOS",
+	"EXISTS", "TYPE", "TTL", "PTTL", "EXPIRETIME", "PEXPIRETIME", "DUMP", "KEYS", "SCAN", "RANDOMKEY", "DBSIZE",
+	"HGET", "HMGET", "HGETALL", "HKEYS", "HVALS", "HLEN", "HEXISTS", "HSTRLEN", "HRANDFIELD", "HSCAN",
+	"LRANGE", "LLEN", "LINDEX", "LPOS",
+	"SMEMBERS", "SISMEMBER", "SMISMEMBER", "SCARD", "SRANDMEMBER", "SINTER", "SINTERCARD", "SUNION", "SDIFF", "SSCAN",
+	"ZRANGE", "ZRANGEBYSCORE", "ZRANGEBYLEX", "ZREVRANGE", "ZREVRANGEBYSCORE", "ZREVRANGEBYLEX",
+	"ZSCORE", "ZMSCORE", "ZCARD", "ZCOUNT", "ZLEXCOUNT", "ZRANK", "ZREVRANK", "ZRANDMEMBER", "ZSCAN",
+	"GEOPOS", "GEODIST", "GEOHASH", "GEORADIUS_RO", "GEORADIUSBYMEMBER_RO", "GEOSEARCH",
+	"XRANGE", "XREVRANGE", "XLEN",
+	0
+};
+
+static const char *blockingCommands[] =
+{
+	"BLPOP", "BRPOP", "BRPOPLPUSH", "BLMOVE", "BLMPOP", "BZPOPMIN", "BZPOPMAX", "BZMPOP",
+	0
+};
+
+// commands without keys, or whose first argument is not a key
+static const char *keylessCommands[] =
+{
+	"PING", "ECHO", "AUTH", "HELLO", "SELECT", "QUIT", "RESET", "CLIENT", "CONFIG", "INFO", "TIME",
+	"DBSIZE", "FLUSHDB", "FLUSHALL", "SAVE", "BGSAVE", "BGREWRITEAOF", "LASTSAVE", "ROLE", "REPLICAOF",
+	"SLAVEOF", "MONITOR", "SLOWLOG", "LATENCY", "MEMORY", "MODULE", "COMMAND", "DEBUG", "SHUTDOWN",
+	"KEYS", "SCAN", "RANDOMKEY", "MULTI", "EXEC", "DISCARD", "UNWATCH", "WAIT", "WAITAOF",
+	"SUBSCRIBE", "UNSUBSCRIBE", "PSUBSCRIBE", "PUNSUBSCRIBE", "PUBLISH", "PUBSUB",
+	"SCRIPT", "FUNCTION", "EVAL", "EVALSHA", "FCALL", "XREAD", "XREADGROUP", "CLUSTER",
+	"READONLY", "READWRITE", "SWAPDB", "ACL",
+	0
+};
+
+// commands taking only keys
+static const char *allKeyCommands[] =
+{
+	"MGET", "DEL", "UNLINK", "EXISTS", "TOUCH", "WATCH", "SINTER", "SUNION", "SDIFF",
+	0
+};
+
+class CodecCommand
+{
+public:
+	const char *name;
+	int firstValue; // -1 if no value arguments
+	int valueStep; // 0 if only one
+	CodecReplyShape reply;
+};
+
+static const CodecCommand codecCommands[] =
+{
+	{ "SET", 2, 0, CodecReplyNone },
+	{ "SETNX", 2, 0, CodecReplyNone },
+	{ "SETEX", 3, 0, CodecReplyNone },
+	{ "PSETEX", 3, 0, CodecReplyNone },
+	{ "GETSET", 2, 0, CodecReplyValue },
+	{ "MSET", 2, 2, CodecReplyNone },
+	{ "MSETNX", 2, 2, CodecReplyNone },
+	{ "GET", -1, 0, CodecReplyValue },
+	{ "GETDEL", -1, 0, CodecReplyValue },
+	{ "GETEX", -1, 0, CodecReplyValue },
+	{ "MGET", -1, 0, CodecReplyList },
+	{ "HSET", 3, 2, CodecReplyNone },
+	{ "HMSET", 3, 2, CodecReplyNone },
+	{ "HSETNX", 3, 0, CodecReplyNone },
+	{ "HGET", -1, 0, CodecReplyValue },
+	{ "HMGET", -1, 0, CodecReplyList },
+	{ "HVALS", -1, 0, CodecReplyList },
+	{ "HGETALL", -1, 0, CodecReplyPairs },
+	{ 0, 0, 0, CodecReplyNone }
+};
+
+class CommandTable
+{
+public:
+	QSet<QByteArray> readOnly;
+	QSet<QByteArray> blocking;
+	QHash<QByteArray, const CodecCommand*> codec;
+	QSet<QByteArray> keyless;
+	QSet<QByteArray> allKeys;
+
+	CommandTable()
+	{
+		for(int n = 0; readOnlyCommands[n]; ++n)
+			readOnly += QByteArray(readOnlyCommands[n]);
+
+		for(int n = 0; blockingCommands[n]; ++n)
+			blocking += QByteArray(blockingCommands[n]);
+
+		for(int n = 0; keylessCommands[n]; ++n)
+			keyless += QByteArray(keylessCommands[n]);
+
+		for(int n = 0; allKeyCommands[n]; ++n)
+			allKeys += QByteArray(allKeyCommands[n]);
+
+		for(int n = 0; codecCommands[n].name; ++n)
+			codec.insert(QByteArray(codecCommands[n].name), &codecCommands[n]);
+	}
+};
+
+Q_GLOBAL_STATIC(CommandTable, g_commands)
+
+bool isReadOnlyCommand(const QByteArray &name)
+{
+	return g_commands()->readOnly.contains(name.toUpper());
+}
+
+bool isBlockingCommand(const QList<QByteArray> &args)
+{
+	QByteArray name = args[0].toUpper();
+	if(g_commands()->blocking.contains(name))
+		return true;
+
+	if(name == "XREAD" || name == "XREADGROUP")
+	{
+		// options come before STREAMS
+		for(int n = 1; n < args.count(); ++n)
+		{
+			QByteArray arg = args[n].toUpper();
+			if(arg == "BLOCK")
+				return true;
+			else if(arg == "STREAMS")
+				break;
+		}
+	}
+
+	return false;
+}
+
+QList<int> commandKeyArgs(const QList<QByteArray> &args)
+{
+	QList<int> out;
+	if(args.count() < 2)
+		return out;
+
+	QByteArray name = args[0].toUpper();
+	if(g_commands()->keyless.contains(name))
+		return out;
+
+	if(g_commands()->allKeys.contains(name))
+	{
+		for(int n = 1; n < args.count(); ++n)
+			out += n;
+	}
+	else if(name == "MSET" || name == "MSETNX")
+	{
+		for(int n = 1; n < args.count(); n += 2)
+			out += n;
+	}
+	else
+		out += 1;
+
+	return out;
+}
+
+bool isCodecCommand(const QByteArray &name)
+{
+	return g_commands()->codec.contains(name.toUpper());
+}
+
+QList<int> codecValueArgs(const QList<QByteArray> &args)
+{
+	QList<int> out;
+
+	const CodecCommand *c = g_commands()->codec.value(args[0].toUpper());
+	if(!c || c->firstValue < 0)
+		return out;
+
+	for(int n = c->firstValue; n < args.count(); n += c->valueStep)
+	{
+		out += n;
+		if(c->valueStep == 0)
+			break;
+	}
+
+	return out;
+}
+
+CodecReplyShape codecReplyShape(const QList<QByteArray> &args)
+{
+	QByteArray name = args[0].toUpper();
+
+	const CodecCommand *c = g_commands()->codec.value(name);
+	if(!c)
+		return CodecReplyNone;
+
+	// the options follow the key and value
+	if(name == "SET")
+	{
+		for(int n = 3; n < args.count(); ++n)
+		{
+			if(qstricmp(args[n].data(), "GET") == 0)
+				return CodecReplyValue;
+		}
+	}
+
+	return c->reply;
+}
+
+}
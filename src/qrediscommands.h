@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISCOMMANDS_H
+#define QREDISCOMMANDS_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace QRedis {
+
+// command names are matched case-insensitively
+
+// commands that never modify the dataset
+bool isReadOnlyCommand(const QByteArray &name);
+
+// commands that may hold the connection until the server has something to
+//   reply with. XREAD and XREADGROUP only count when given BLOCK
+bool isBlockingCommand(const QList<QByteArray> &args);
+
+// positions of the key arguments. this is a heuristic: most commands take
+//   a single key as their first argument, and the common multi-key ones
+//   are known. commands known to take no key yield nothing
+QList<int> commandKeyArgs(const QList<QByteArray> &args);
+
+// where the values are in the arguments and replies of commands a value
+//   codec supports
+enum CodecReplyShape
+{
+	CodecReplyNone, // the reply has no values
+	CodecReplyValue, // the reply is a value
+	CodecReplyList, // the reply is a list of values
+	CodecReplyPairs // the reply alternates between field and value
+};
+
+// a command name from a codec command list is supported if it is known
+//   here
+bool isCodecCommand(const QByteArray &name);
+
+// positions of the value arguments
+QList<int> codecValueArgs(const QList<QByteArray> &args);
+
+// SET replies with a value when given the GET option
+CodecReplyShape codecReplyShape(const QList<QByteArray> &args);
+
+}
+
+#endif
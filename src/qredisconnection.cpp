@@ -0,0 +1,665 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisconnection.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QTimer>
+#include <QMutex>
+#include <QDateTime>
+#include <QHostInfo>
+#include <QHostAddress>
+#include "redisqtadapter.h"
+#include "qredisreplybuilder.h"
+#include "qredisrecorder.h"
+
+namespace QRedis {
+
+class GlobalContext
+{
+public:
+	QMutex m;
+	QHash<const redisAsyncContext*, void*> contextMap;
+};
+
+Q_GLOBAL_STATIC(GlobalContext, g_context)
+
+// hiredis has no API for this, so it reads the private output buffer.
+//   checked against hiredis 0.13, 0.14 and 1.0 through 1.2, where obuf is
+//   an sds string: NUL-terminated, and replaced by an empty one once all
+//   of it is written. a command is never empty, so the first byte tells.
+//   sds.h is not included, since not every install of hiredis ships it
+static bool hasUnwrittenOutput(const redisAsyncContext *ac)
+{
+	return (ac->c.obuf && ac->c.obuf[0] != '\0');
+}
+
+// hiredis passes the replies of these to the subscription callbacks
+static bool isUnsubscribe(const QByteArray &command)
+{
+	return (qstricmp(command.data(), "UNSUBSCRIBE") == 0 || qstricmp(command.data(), "PUNSUBSCRIBE") == 0);
+}
+
+// QHostInfo doesn't report record TTLs, so entries live for a fixed time
+class HostCache
+{
+public:
+	class Entry
+	{
+	public:
+		QList<QHostAddress> addresses;
+		qint64 expires;
+	};
+
+	QMutex m;
+	int ttl;
+	QHash<QString, Entry> entries;
+
+	HostCache() :
+		ttl(60000)
+	{
+	}
+
+	QList<QHostAddress> get(const QString &host)
+	{
+		QMutexLocker locker(&m);
+
+		QHash<QString, Entry>::iterator it = entries.find(host);
+		if(it == entries.end())
+			return QList<QHostAddress>();
+
+		if(it.value().expires <= QDateTime::currentMSecsSinceEpoch())
+		{
+			entries.erase(it);
+			return QList<QHostAddress>();
+		}
+
+		return it.value().addresses;
+	}
+
+	void put(const QString &host, const QList<QHostAddress> &addresses)
+	{
+		QMutexLocker locker(&m);
+
+		if(ttl <= 0)
+			return;
+
+		Entry e;
+		e.addresses = addresses;
+		e.expires = QDateTime::currentMSecsSinceEpoch() + ttl;
+		entries.insert(host, e);
+	}
+
+	void remove(const QString &host)
+	{
+		QMutexLocker locker(&m);
+		entries.remove(host);
+	}
+};
+
+Q_GLOBAL_STATIC(HostCache, g_hostCache)
+
+class Connection::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class PendingCommand
+	{
+	public:
+		int id;
+		QList<QByteArray> args;
+		CommandCallback fn;
+		void *privdata;
+	};
+
+	Connection *q;
+	QString host;
+	int port;
+	bool active;
+	RedisQtAdapter *adapter;
+	redisAsyncContext *ac;
+	redisAsyncContext *oldAc;
+	QTimer *reconnectTimer;
+	int lookupId;
+	QList<QHostAddress> addresses;
+	int addressIndex;
+	QList<QList<QByteArray> > handshake;
+	int handshakePending;
+	QList<PendingCommand> pending;
+	Recorder *recorder;
+	QHash<int, quint64> recordIds; // command id -> recorder id
+	ReplyBuilderContext builderContext;
+	int nextPendingId;
+	bool flushScheduled;
+
+	Private(Connection *_q) :
+		QObject(_q),
+		q(_q),
+		active(false),
+		adapter(0),
+		ac(0),
+		oldAc(0),
+		lookupId(-1),
+		addressIndex(0),
+		handshakePending(0),
+		recorder(0),
+		nextPendingId(0),
+		flushScheduled(false)
+	{
+		reconnectTimer = new QTimer(this);
+		connect(reconnectTimer, SIGNAL(timeout()), SLOT(reconnect_timeout()));
+		reconnectTimer->setSingleShot(true);
+		reconnectTimer->setInterval(1000);
+	}
+
+	~Private()
+	{
+		if(lookupId != -1)
+			QHostInfo::abortHostLookup(lookupId);
+
+		// like hiredis does for commands it holds
+		foreach(const PendingCommand &c, pending)
+		{
+			if(c.fn)
+				c.fn(ac, 0, c.privdata);
+		}
+
+		cleanup();
+
+		reconnectTimer->disconnect(this);
+		reconnectTimer->setParent(0);
+		reconnectTimer->deleteLater();
+	}
+
+	static void contextMapAdd(const redisAsyncContext *ac, Private *cp)
+	{
+		QMutexLocker locker(&(g_context()->m));
+		g_context()->contextMap.insert(ac, cp);
+	}
+
+	static void contextMapRemove(const redisAsyncContext *ac)
+	{
+		QMutexLocker locker(&(g_context()->m));
+		g_context()->contextMap.remove(ac);
+	}
+
+	static Private *contextMapGet(const redisAsyncContext *ac)
+	{
+		QMutexLocker locker(&(g_context()->m));
+		return (Private *)g_context()->contextMap.value(ac);
+	}
+
+	void cleanup()
+	{
+		if(ac)
+		{
+			redisAsyncFree(ac);
+			oldAc = ac;
+			ac = 0;
+		}
+
+		// whatever wasn't reported by now never will be
+		foreach(quint64 recordId, recordIds)
+			recorder->recordReply(recordId, 0);
+		recordIds.clear();
+
+		delete adapter;
+		adapter = 0;
+
+		if(oldAc)
+		{
+			contextMapRemove(oldAc);
+			oldAc = 0;
+		}
+	}
+
+	int enqueue(const QList<QByteArray> &args, CommandCallback fn, void *privdata)
+	{
+		PendingCommand c;
+		c.id = nextPendingId++;
+		c.args = args;
+		c.fn = fn;
+		c.privdata = privdata;
+		pending += c;
+
+		if(!flushScheduled)
+		{
+			flushScheduled = true;
+			QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+		}
+
+		return c.id;
+	}
+
+	void setRecorder(Recorder *_recorder)
+	{
+		// ids of the previous recorder mean nothing to the next one
+		recorder = _recorder;
+		recordIds.clear();
+	}
+
+	void recordReply(int id, const void *reply)
+	{
+		QHash<int, quint64>::iterator it = recordIds.find(id);
+		if(it == recordIds.end())
+			return;
+
+		// the builder counted the size while parsing
+		if(reply)
+			recorder->recordReply(it.value(), replyBuilderSize(reply));
+		else
+			recorder->recordFailure(it.value());
+		recordIds.erase(it);
+	}
+
+	bool cancel(int id)
+	{
+		for(int n = 0; n < pending.count(); ++n)
+		{
+			if(pending[n].id == id)
+			{
+				pending.removeAt(n);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void connectToServer(const QString &_host, int _port)
+	{
+		assert(!active);
+
+		active = true;
+		host = _host;
+		port = _port;
+
+		doConnect();
+	}
+
+private:
+	// hiredis resolves names with a blocking getaddrinfo call, so names are
+	//   resolved here first and hiredis is only ever given literal addresses
+	void doConnect()
+	{
+		assert(!ac);
+
+		QHostAddress literal;
+		if(literal.setAddress(host))
+		{
+			addresses = QList<QHostAddress>() << literal;
+			connectAddress(0);
+			return;
+		}
+
+		addresses = g_hostCache()->get(host);
+		if(!addresses.isEmpty())
+		{
+			connectAddress(0);
+			return;
+		}
+
+		lookupId = QHostInfo::lookupHost(host, this, SLOT(lookup_finished(const QHostInfo &)));
+	}
+
+	void connectAddress(int index)
+	{
+		assert(!ac);
+
+		addressIndex = index;
+
+		ac = redisAsyncConnect(addresses[index].toString().toUtf8(), port);
+		assert(ac);
+
+		contextMapAdd(ac, this);
+
+		if(ac->err != 0)
+		{
+			handleConnect(REDIS_ERR);
+			return;
+		}
+
+		installReplyBuilder(ac, &builderContext);
+
+		adapter = new RedisQtAdapter(this);
+		adapter->setContext(ac);
+		connect(adapter, SIGNAL(written()), SLOT(flush()));
+
+		redisAsyncSetConnectCallback(ac, cb_connected);
+		redisAsyncSetDisconnectCallback(ac, cb_disconnected);
+
+		sendHandshake();
+	}
+
+	// the setup commands are queued before anything else can be, so they
+	//   go out first
+	void sendHandshake()
+	{
+		handshakePending = 0;
+
+		foreach(const QList<QByteArray> &args, handshake)
+		{
+			const char **argv = (const char **)malloc(args.count() * sizeof(char *));
+			size_t *argvlen = (size_t *)malloc(args.count() * sizeof(size_t));
+
+			for(int n = 0; n < args.count(); ++n)
+			{
+				argv[n] = args[n].data();
+				argvlen[n] = args[n].length();
+			}
+
+			int ret = redisAsyncCommandArgv(ac, cb_handshake, 0, args.count(), argv, argvlen);
+			free(argvlen);
+			free(argv);
+
+			if(ret == REDIS_OK)
+				++handshakePending;
+		}
+	}
+
+	static void cb_handshake(redisAsyncContext *c, void *reply, void *privdata)
+	{
+		Q_UNUSED(privdata);
+
+		// the context is going away
+		if(!reply)
+			return;
+
+		Private *self = contextMapGet(c);
+		assert(self);
+
+		self->cb_handshake((redisReply *)reply);
+	}
+
+	static void cb_recorded(redisAsyncContext *c, void *reply, void *privdata)
+	{
+		Private *self = contextMapGet(c);
+		assert(self);
+
+		self->recordReply((int)(quintptr)privdata, reply);
+	}
+
+	static void cb_connected(const redisAsyncContext *c, int status)
+	{
+		Private *self = contextMapGet(c);
+		assert(self);
+
+		self->cb_connected(status);
+	}
+
+	static void cb_disconnected(const redisAsyncContext *c, int status)
+	{
+		Private *self = contextMapGet(c);
+		assert(self);
+
+		self->cb_disconnected(status);
+	}
+
+	void cb_handshake(redisReply *reply)
+	{
+		if(handshakePending == 0)
+			return;
+
+		if(reply->type == REDIS_REPLY_ERROR)
+		{
+			handshakePending = 0;
+			QByteArray message(reply->str, (int)reply->len);
+			QMetaObject::invokeMethod(this, "handleHandshakeError", Qt::QueuedConnection, Q_ARG(QByteArray, message));
+			return;
+		}
+
+		--handshakePending;
+		if(handshakePending == 0)
+			QMetaObject::invokeMethod(this, "handleConnect", Qt::QueuedConnection, Q_ARG(int, REDIS_OK));
+	}
+
+	void cb_connected(int status)
+	{
+		// with a handshake, connected() waits for its replies
+		if(status == REDIS_OK && handshakePending > 0)
+			return;
+
+		if(status == REDIS_ERR)
+		{
+			// hiredis will free ac after this method returns, but we need to remember
+			//   the pointer for cleanup
+
+			// only do the switch if we haven't yet
+			if(ac)
+			{
+				ac->c.fd = -1;
+				oldAc = ac;
+				ac = 0;
+			}
+		}
+
+		QMetaObject::invokeMethod(this, "handleConnect", Qt::QueuedConnection, Q_ARG(int, status));
+	}
+
+	void cb_disconnected(int status)
+	{
+		// if we were explicitly disconnecting, don't react to this callback
+		if(status == REDIS_OK)
+			return;
+
+		// hiredis will free ac after this method returns, but we need to remember
+		//   the pointer for cleanup
+
+		// only do the switch if we haven't yet
+		if(ac)
+		{
+			oldAc = ac;
+			ac = 0;
+		}
+
+		QMetaObject::invokeMethod(this, "handleDisconnect", Qt::QueuedConnection, Q_ARG(int, status));
+	}
+
+private slots:
+	void flush()
+	{
+		flushScheduled = false;
+
+		// kept until hiredis has connected and written out everything it
+		//   was given before. the adapter calls this again after each
+		//   write, so they go out together on the next one
+		if(!ac || !(ac->c.flags & REDIS_CONNECTED) || hasUnwrittenOutput(ac) || pending.isEmpty())
+			return;
+
+		QList<PendingCommand> cmds = pending;
+		pending.clear();
+
+		foreach(const PendingCommand &c, cmds)
+		{
+			const char **argv = (const char **)malloc(c.args.count() * sizeof(char *));
+			size_t *argvlen = (size_t *)malloc(c.args.count() * sizeof(size_t));
+
+			for(int n = 0; n < c.args.count(); ++n)
+			{
+				const QByteArray &arg = c.args[n];
+				assert(!arg.isNull());
+				argv[n] = arg.data();
+				argvlen[n] = arg.length();
+			}
+
+			bool record = (recorder && !isUnsubscribe(c.args[0]));
+
+			int ret;
+			if(record && !c.fn)
+				ret = redisAsyncCommandArgv(ac, cb_recorded, (void *)(quintptr)c.id, c.args.count(), argv, argvlen);
+			else
+				ret = redisAsyncCommandArgv(ac, c.fn, c.privdata, c.args.count(), argv, argvlen);
+			free(argvlen);
+			free(argv);
+
+			if(ret == REDIS_ERR)
+			{
+				if(c.fn)
+					c.fn(ac, 0, c.privdata);
+				continue;
+			}
+
+			if(record)
+				recordIds.insert(c.id, recorder->recordCommand(c.args));
+		}
+	}
+
+	void lookup_finished(const QHostInfo &info)
+	{
+		lookupId = -1;
+
+		if(info.error() != QHostInfo::NoError || info.addresses().isEmpty())
+		{
+			reconnectTimer->start();
+			return;
+		}
+
+		addresses = info.addresses();
+		g_hostCache()->put(host, addresses);
+
+		connectAddress(0);
+	}
+
+	void handleConnect(int status)
+	{
+		if(status == REDIS_ERR)
+		{
+			cleanup();
+
+			// try the remaining addresses of the name in order
+			if(addressIndex + 1 < addresses.count())
+			{
+				connectAddress(addressIndex + 1);
+				return;
+			}
+
+			// none worked, so resolve again on the next attempt
+			g_hostCache()->remove(host);
+
+			reconnectTimer->start();
+			return;
+		}
+
+		if(!pending.isEmpty())
+			flush();
+
+		emit q->connected();
+	}
+
+	void handleDisconnect(int status)
+	{
+		cleanup();
+
+		if(status == REDIS_ERR)
+			reconnectTimer->start();
+
+		emit q->disconnected();
+	}
+
+	void handleHandshakeError(const QByteArray &message)
+	{
+		// commands queued behind the handshake fail along with the context
+		cleanup();
+		reconnectTimer->start();
+
+		emit q->setupFailed(message);
+	}
+
+	void reconnect_timeout()
+	{
+		doConnect();
+	}
+};
+
+Connection::Connection(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+Connection::~Connection()
+{
+	delete d;
+}
+
+void Connection::setReconnectInterval(int msecs)
+{
+	d->reconnectTimer->setInterval(msecs);
+}
+
+void Connection::setHandshake(const QList<QList<QByteArray> > &commands)
+{
+	d->handshake = commands;
+}
+
+void Connection::connectToServer(const QString &host, int port)
+{
+	d->connectToServer(host, port);
+}
+
+redisAsyncContext *Connection::context() const
+{
+	return d->ac;
+}
+
+int Connection::enqueue(const QList<QByteArray> &args, CommandCallback fn, void *privdata)
+{
+	return d->enqueue(args, fn, privdata);
+}
+
+bool Connection::cancel(int id)
+{
+	return d->cancel(id);
+}
+
+void Connection::setRecorder(Recorder *recorder)
+{
+	d->setRecorder(recorder);
+}
+
+void Connection::recordReply(int id, const void *reply)
+{
+	d->recordReply(id, reply);
+}
+
+void Connection::setChunkHandler(const void *privdata, ReplyChunkHandler *handler)
+{
+	d->builderContext.chunkHandlers.insert(privdata, handler);
+}
+
+void Connection::removeChunkHandler(const void *privdata)
+{
+	d->builderContext.chunkHandlers.remove(privdata);
+}
+
+void Connection::setHostCacheTtl(int msecs)
+{
+	QMutexLocker locker(&(g_hostCache()->m));
+	g_hostCache()->ttl = msecs;
+}
+
+}
+
+#include "qredisconnection.moc"
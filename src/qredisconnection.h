@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISCONNECTION_H
+#define QREDISCONNECTION_H
+
+#include <QObject>
+#include <QList>
+#include <QByteArray>
+
+extern "C" {
+struct redisAsyncContext;
+}
+
+namespace QRedis {
+
+class ReplyChunkHandler;
+class Recorder;
+class Connection;
+
+// waits for a connection leased from a Client
+class LeaseWaiter
+{
+public:
+	virtual ~LeaseWaiter() {}
+
+	virtual void leaseReady(Connection *conn) = 0;
+};
+
+// a single hiredis connection that reconnects automatically. a Client
+//   owns one or more of these
+class Connection : public QObject
+{
+	Q_OBJECT
+
+public:
+	// same as hiredis' redisCallbackFn
+	typedef void (*CommandCallback)(redisAsyncContext *ac, void *reply, void *privdata);
+
+	Connection(QObject *parent = 0);
+	~Connection();
+
+	void setReconnectInterval(int msecs);
+
+	// commands sent first on every connect. connected() is emitted once
+	//   all of them succeed, and an error reply fails the connect attempt
+	void setHandshake(const QList<QList<QByteArray> > &commands);
+
+	void connectToServer(const QString &host, int port);
+
+	// may be non-null before connected() is emitted, in which case hiredis
+	//   holds commands until the connection is established. null between
+	//   reconnects
+	redisAsyncContext *context() const;
+
+	// commands are collected and handed to hiredis together once the
+	//   connection is up and hiredis has written out the commands before
+	//   them, so they wait while the socket is not writable. until then
+	//   they can be taken back. if hiredis refuses a command, the callback
+	//   gets a null reply. returns an id for cancel()
+	int enqueue(const QList<QByteArray> &args, CommandCallback fn, void *privdata);
+
+	// returns false if the command was already handed to hiredis
+	bool cancel(int id);
+
+	// while set, each command is logged as it is handed to hiredis, except
+	//   for (P)UNSUBSCRIBE which gets no reply of its own. whoever takes
+	//   the reply of a command passes the reply object here by id, or null
+	//   if the command failed or was abandoned. replies to commands without
+	//   a callback are logged by the connection itself
+	void setRecorder(Recorder *recorder);
+	void recordReply(int id, const void *reply);
+
+	// an array reply to the command with this privdata is passed to the
+	//   handler in pieces as it is parsed
+	void setChunkHandler(const void *privdata, ReplyChunkHandler *handler);
+	void removeChunkHandler(const void *privdata);
+
+	// resolved host addresses are shared by all connections and kept for
+	//   this long. zero disables the cache. default 60000
+	static void setHostCacheTtl(int msecs);
+
+signals:
+	void connected();
+	void disconnected();
+
+	// a setup command was refused. the connection tries again after the
+	//   reconnect interval
+	void setupFailed(const QByteArray &message);
+
+private:
+	Q_DISABLE_COPY(Connection)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
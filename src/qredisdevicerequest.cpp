@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisdevicerequest.h"
+
+#include <assert.h>
+#include <QPointer>
+#include <QVariant>
+#include <QIODevice>
+#include <QUuid>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+
+// the temporary key of an upload expires on its own if the upload is
+//   abandoned without cleanup
+#define UPLOAD_TTL 3600000
+
+namespace QRedis {
+
+class DeviceRequest::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Mode
+	{
+		Upload,
+		Download
+	};
+
+	enum State
+	{
+		Idle,
+		Sizing,
+		Transferring,
+		Committing
+	};
+
+	class Chunk
+	{
+	public:
+		Request *req;
+		int size;
+		QByteArray data;
+		bool done;
+
+		Chunk() :
+			req(0),
+			size(0),
+			done(false)
+		{
+		}
+	};
+
+	DeviceRequest *q;
+	Client *client;
+	int chunkSize;
+	int maxInFlight;
+	Mode mode;
+	State state;
+	QByteArray key;
+	QByteArray tmpKey;
+	QIODevice *device;
+	bool inputFinished;
+	bool first;
+	qint64 next;
+	qint64 done;
+	qint64 total;
+	QList<Chunk> chunks; // in command order
+	QList<Request*> commitReqs;
+
+	Private(DeviceRequest *_q) :
+		QObject(_q),
+		q(_q),
+		client(0),
+		chunkSize(65536),
+		maxInFlight(8),
+		mode(Upload),
+		state(Idle),
+		device(0),
+		inputFinished(false),
+		first(true),
+		next(0),
+		done(0),
+		total(-1)
+	{
+	}
+
+	~Private()
+	{
+		cleanup();
+	}
+
+	void cleanup()
+	{
+		foreach(const Chunk &c, chunks)
+			delete c.req;
+		chunks.clear();
+
+		qDeleteAll(commitReqs);
+		commitReqs.clear();
+
+		if(device)
+		{
+			device->disconnect(this);
+			device = 0;
+		}
+	}
+
+	void start(Mode _mode, const QByteArray &_key, QIODevice *_device)
+	{
+		assert(state == Idle);
+		assert(_device);
+
+		mode = _mode;
+		key = _key;
+		device = _device;
+		first = true;
+		next = 0;
+		done = 0;
+
+		if(mode == Upload)
+		{
+			// unique across processes, so concurrent uploads of the same
+			//   key never append to each other's data
+			tmpKey = key + ".upload-" + QUuid::createUuid().toRfc4122().toHex();
+
+			if(device->isSequential())
+			{
+				total = -1;
+				inputFinished = false;
+				connect(device, SIGNAL(readyRead()), SLOT(device_readyRead()));
+				connect(device, SIGNAL(readChannelFinished()), SLOT(device_readChannelFinished()));
+			}
+			else
+			{
+				total = device->size() - device->pos();
+				inputFinished = true;
+			}
+
+			state = Transferring;
+
+			// a device with nothing buffered yet may not emit anything
+			//   until more data arrives, so always make a first pass
+			QMetaObject::invokeMethod(this, "sendChunks", Qt::QueuedConnection);
+		}
+		else // Download
+		{
+			state = Sizing;
+
+			Request *req = client->createRequest();
+			connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(size_readyRead(const QRedis::Reply &)));
+			connect(req, SIGNAL(error()), SLOT(commit_error()));
+			commitReqs += req;
+			req->start("STRLEN", key);
+		}
+	}
+
+private:
+	Request *createChunkRequest()
+	{
+		Request *req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(chunk_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(chunk_error()));
+		return req;
+	}
+
+	// leaves buf empty if no input is ready. returns false on a read error
+	bool readInput(QByteArray *buf)
+	{
+		if(device->isSequential() && !inputFinished && device->bytesAvailable() < chunkSize)
+			return true;
+
+		*buf = device->read(chunkSize);
+		return !(buf->isEmpty() && !inputDone());
+	}
+
+	bool inputDone() const
+	{
+		if(device->isSequential())
+			return inputFinished && device->bytesAvailable() == 0;
+		else
+			return device->atEnd();
+	}
+
+	void commit()
+	{
+		state = Committing;
+
+		if(first)
+		{
+			// empty input
+			Request *req = client->createRequest();
+			commitReqs += req;
+			req->start("SET", tmpKey, "", "PX", QByteArray::number(UPLOAD_TTL));
+		}
+
+		// pipelined. the expiry is removed before the rename, since RENAME
+		//   carries it over to the destination. if the rename then fails,
+		//   the temporary key is deleted. the commit completes when the
+		//   last reply arrives
+		Request *req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(persist_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(commit_error()));
+		commitReqs += req;
+		req->start("PERSIST", tmpKey);
+
+		req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(commit_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(commit_error()));
+		commitReqs += req;
+		req->start("RENAME", tmpKey, key);
+	}
+
+	void abandonUpload()
+	{
+		// best effort. the key expires anyway
+		Request *req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), req, SLOT(deleteLater()));
+		connect(req, SIGNAL(error()), req, SLOT(deleteLater()));
+		req->del(tmpKey);
+	}
+
+	void flushDownload()
+	{
+		while(!chunks.isEmpty() && chunks.first().done)
+		{
+			Chunk c = chunks.takeFirst();
+			if(device->write(c.data) != c.data.size())
+			{
+				handleError();
+				return;
+			}
+
+			done += c.data.size();
+		}
+	}
+
+	void handleFinished(const QVariant &value)
+	{
+		cleanup();
+		state = Idle;
+
+		Reply r;
+		r.value = value;
+		emit q->readyRead(r);
+	}
+
+	void handleError()
+	{
+		if(mode == Upload && state != Idle)
+			abandonUpload();
+
+		cleanup();
+		state = Idle;
+
+		emit q->error();
+	}
+
+private slots:
+	void sendChunks()
+	{
+		if(state != Transferring)
+			return;
+
+		while(chunks.count() < maxInFlight)
+		{
+			Chunk c;
+
+			if(mode == Upload)
+			{
+				QByteArray buf;
+				if(!readInput(&buf))
+				{
+					handleError();
+					return;
+				}
+
+				if(buf.isEmpty())
+					break;
+
+				// APPEND rather than SET, so a client codec never touches
+				//   the pieces
+				c.req = createChunkRequest();
+				c.size = buf.size();
+				c.req->start("APPEND", tmpKey, buf);
+
+				if(first)
+				{
+					Request *req = client->createRequest();
+					commitReqs += req;
+					req->start("PEXPIRE", tmpKey, QByteArray::number(UPLOAD_TTL));
+					first = false;
+				}
+			}
+			else // Download
+			{
+				if(next >= total)
+					break;
+
+				c.size = (int)qMin((qint64)chunkSize, total - next);
+				c.req = createChunkRequest();
+				c.req->start("GETRANGE", key, QByteArray::number(next), QByteArray::number(next + c.size - 1));
+			}
+
+			next += c.size;
+			chunks += c;
+		}
+
+		if(mode == Upload && chunks.isEmpty() && inputDone())
+			commit();
+	}
+
+	void device_readyRead()
+	{
+		sendChunks();
+	}
+
+	void device_readChannelFinished()
+	{
+		inputFinished = true;
+		sendChunks();
+	}
+
+	void size_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+		commitReqs.removeAll(req);
+		delete req;
+
+		if(reply.value.type() != QVariant::LongLong)
+		{
+			// error reply, such as WRONGTYPE
+			handleError();
+			return;
+		}
+
+		total = reply.value.toLongLong();
+		state = Transferring;
+
+		if(total == 0)
+		{
+			handleFinished((qlonglong)0);
+			return;
+		}
+
+		sendChunks();
+	}
+
+	void chunk_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+
+		int at = -1;
+		for(int n = 0; n < chunks.count(); ++n)
+		{
+			if(chunks[n].req == req)
+			{
+				at = n;
+				break;
+			}
+		}
+		assert(at != -1);
+
+		Chunk &c = chunks[at];
+		c.req = 0;
+		delete req;
+
+		if(mode == Upload)
+		{
+			// APPEND replies with the new length
+			if(reply.value.type() != QVariant::LongLong)
+			{
+				handleError();
+				return;
+			}
+
+			done += c.size;
+			chunks.removeAt(at);
+		}
+		else // Download
+		{
+			c.data = reply.value.toByteArray();
+			c.done = true;
+
+			// the value shrank or changed type while being read
+			if(reply.value.type() != QVariant::ByteArray || c.data.size() != c.size)
+			{
+				handleError();
+				return;
+			}
+
+			flushDownload();
+			if(state == Idle)
+				return;
+		}
+
+		sendChunks();
+		if(state == Idle)
+			return;
+
+		QPointer<QObject> self = this;
+		emit q->progress(done, total);
+		if(!self)
+			return;
+
+		if(mode == Download && done == total)
+			handleFinished((qlonglong)total);
+	}
+
+	void chunk_error()
+	{
+		Request *req = (Request *)sender();
+		for(int n = 0; n < chunks.count(); ++n)
+		{
+			if(chunks[n].req == req)
+			{
+				chunks[n].req = 0;
+				break;
+			}
+		}
+		delete req;
+
+		handleError();
+	}
+
+	void persist_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+		commitReqs.removeAll(req);
+		delete req;
+
+		// the temporary key always has an expiry, so 0 means it expired
+		if(reply.value.toLongLong() != 1)
+		{
+			handleError();
+			return;
+		}
+	}
+
+	void commit_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+		commitReqs.removeAll(req);
+		delete req;
+
+		if(reply.error)
+		{
+			handleError();
+			return;
+		}
+
+		handleFinished(QByteArray("OK"));
+	}
+
+	void commit_error()
+	{
+		Request *req = (Request *)sender();
+		commitReqs.removeAll(req);
+		delete req;
+
+		handleError();
+	}
+};
+
+DeviceRequest::DeviceRequest(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+DeviceRequest::~DeviceRequest()
+{
+	delete d;
+}
+
+void DeviceRequest::setChunkSize(int size)
+{
+	assert(size > 0);
+
+	d->chunkSize = size;
+}
+
+void DeviceRequest::setMaxChunksInFlight(int count)
+{
+	assert(count > 0);
+
+	d->maxInFlight = count;
+}
+
+void DeviceRequest::setFromDevice(const QByteArray &key, QIODevice *device)
+{
+	d->start(Private::Upload, key, device);
+}
+
+void DeviceRequest::getToDevice(const QByteArray &key, QIODevice *device)
+{
+	d->start(Private::Download, key, device);
+}
+
+void DeviceRequest::setup(Client *client)
+{
+	d->client = client;
+}
+
+}
+
+#include "qredisdevicerequest.moc"
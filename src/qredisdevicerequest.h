@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISDEVICEREQUEST_H
+#define QREDISDEVICEREQUEST_H
+
+#include <QObject>
+
+class QIODevice;
+
+namespace QRedis {
+
+class Client;
+class Reply;
+
+// moves a string value between redis and a QIODevice in fixed-size
+//   pieces, keeping a limited number of pieces outstanding, so neither the
+//   client nor hiredis ever buffers the whole value
+class DeviceRequest : public QObject
+{
+	Q_OBJECT
+
+public:
+	~DeviceRequest();
+
+	// bytes per command. default 65536
+	void setChunkSize(int size);
+
+	// number of chunks sent but not yet answered. default 8
+	void setMaxChunksInFlight(int count);
+
+	// reads the device until its end and stores the content under key.
+	//   the data is appended to a temporary key that is renamed into place
+	//   at the end, so readers never see a partial value. sequential
+	//   devices are read as data arrives, until readChannelFinished().
+	//   replies with OK
+	void setFromDevice(const QByteArray &key, QIODevice *device);
+
+	// writes the value of key to the device, in order, using GETRANGE. the
+	//   value should not be modified while it is being read. replies with
+	//   the number of bytes written
+	void getToDevice(const QByteArray &key, QIODevice *device);
+
+signals:
+	// total is -1 if the size of the input is not known in advance
+	void progress(qint64 done, qint64 total);
+	void readyRead(const QRedis::Reply &reply);
+	void error();
+
+private:
+	Q_DISABLE_COPY(DeviceRequest)
+
+	friend class Client;
+	DeviceRequest(QObject *parent = 0);
+	void setup(Client *client);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qrediskeysampler.h"
+
+#include <assert.h>
+
+// with 4 rows of 4096 counters, an estimate exceeds the true count by more
+//   than 0.07% of all samples with a probability under 2%
+#define SKETCH_DEPTH 4
+#define SKETCH_WIDTH 4096
+
+namespace QRedis {
+
+static bool hotKeyGreaterThan(const HotKey &a, const HotKey &b)
+{
+	return a.count > b.count;
+}
+
+static bool bigKeyGreaterThan(const BigKey &a, const BigKey &b)
+{
+	return a.size > b.size;
+}
+
+void KeySampler::Heap::offer(const QByteArray &key, const QByteArray &command, qint64 value)
+{
+	int at = positions.value(key, -1);
+	if(at != -1)
+	{
+		if(value <= items[at].value)
+			return;
+
+		items[at].value = value;
+		items[at].command = command;
+		siftDown(at);
+		return;
+	}
+
+	if(items.count() < capacity)
+	{
+		HeapItem i;
+		i.key = key;
+		i.command = command;
+		i.value = value;
+		items += i;
+		positions.insert(key, items.count() - 1);
+		siftUp(items.count() - 1);
+		return;
+	}
+
+	if(value <= items[0].value)
+		return;
+
+	// replace the smallest
+	positions.remove(items[0].key);
+	items[0].key = key;
+	items[0].command = command;
+	items[0].value = value;
+	positions.insert(key, 0);
+	siftDown(0);
+}
+
+void KeySampler::Heap::clear()
+{
+	items.clear();
+	positions.clear();
+}
+
+void KeySampler::Heap::swap(int a, int b)
+{
+	qSwap(items[a], items[b]);
+	positions[items[a].key] = a;
+	positions[items[b].key] = b;
+}
+
+void KeySampler::Heap::siftUp(int at)
+{
+	while(at > 0)
+	{
+		int parent = (at - 1) / 2;
+		if(items[parent].value <= items[at].value)
+			break;
+
+		swap(at, parent);
+		at = parent;
+	}
+}
+
+void KeySampler::Heap::siftDown(int at)
+{
+	while(true)
+	{
+		int smallest = at;
+		int left = at * 2 + 1;
+		int right = left + 1;
+		if(left < items.count() && items[left].value < items[smallest].value)
+			smallest = left;
+		if(right < items.count() && items[right].value < items[smallest].value)
+			smallest = right;
+
+		if(smallest == at)
+			break;
+
+		swap(at, smallest);
+		at = smallest;
+	}
+}
+
+KeySampler::KeySampler(int hotCount, int bigCount) :
+	sampleEvery(1),
+	tick(0)
+{
+	sketch.fill(0, SKETCH_DEPTH * SKETCH_WIDTH);
+	hot.capacity = hotCount;
+	big.capacity = bigCount;
+}
+
+void KeySampler::setSampleEvery(int n)
+{
+	assert(n > 0);
+
+	sampleEvery = n;
+	tick = 0;
+}
+
+// conservative update: only the smallest counters are raised, which keeps
+//   the overestimate from collisions down
+quint32 KeySampler::sketchAdd(const QByteArray &key)
+{
+	// double hashing gives the row indexes from two hashes
+	uint h1 = qHash(key);
+	uint h2 = qHash(key, 0x9e3779b9) | 1;
+
+	int at[SKETCH_DEPTH];
+	quint32 min = 0xffffffff;
+	for(int n = 0; n < SKETCH_DEPTH; ++n)
+	{
+		at[n] = n * SKETCH_WIDTH + ((h1 + n * h2) & (SKETCH_WIDTH - 1));
+		min = qMin(min, sketch[at[n]]);
+	}
+
+	++min;
+	for(int n = 0; n < SKETCH_DEPTH; ++n)
+	{
+		if(sketch[at[n]] < min)
+			sketch[at[n]] = min;
+	}
+
+	return min;
+}
+
+void KeySampler::addKey(const QByteArray &key)
+{
+	quint32 count = sketchAdd(key);
+	hot.offer(key, QByteArray(), count);
+}
+
+void KeySampler::addReply(const QByteArray &key, const QByteArray &command, qint64 size)
+{
+	big.offer(key, command, size);
+}
+
+QList<HotKey> KeySampler::hotKeys() const
+{
+	QList<HotKey> out;
+	foreach(const HeapItem &i, hot.items)
+	{
+		HotKey k;
+		k.key = i.key;
+		k.count = i.value * sampleEvery;
+		out += k;
+	}
+
+	qSort(out.begin(), out.end(), hotKeyGreaterThan);
+	return out;
+}
+
+QList<BigKey> KeySampler::bigKeys() const
+{
+	QList<BigKey> out;
+	foreach(const HeapItem &i, big.items)
+	{
+		BigKey k;
+		k.key = i.key;
+		k.command = i.command;
+		k.size = i.value;
+		out += k;
+	}
+
+	qSort(out.begin(), out.end(), bigKeyGreaterThan);
+	return out;
+}
+
+void KeySampler::decay()
+{
+	for(int n = 0; n < sketch.count(); ++n)
+		sketch[n] /= 2;
+
+	// halving every value keeps the heap order
+	for(int n = 0; n < hot.items.count(); ++n)
+		hot.items[n].value /= 2;
+}
+
+void KeySampler::clear()
+{
+	sketch.fill(0);
+	hot.clear();
+	big.clear();
+	tick = 0;
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISKEYSAMPLER_H
+#define QREDISKEYSAMPLER_H
+
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+
+namespace QRedis {
+
+class HotKey
+{
+public:
+	QByteArray key;
+	qint64 count; // estimated commands, scaled up by the sampling rate
+};
+
+class BigKey
+{
+public:
+	QByteArray key;
+	QByteArray command;
+	qint64 size; // bytes in the reply
+};
+
+// tracks the most used keys with a count-min sketch feeding a top-k heap,
+//   and the keys with the largest replies. Client owns one of these while
+//   sampling
+class KeySampler
+{
+public:
+	KeySampler(int hotCount = 32, int bigCount = 16);
+
+	void setSampleEvery(int n);
+
+	// returns true for one in every n calls
+	bool shouldSample()
+	{
+		if(++tick < sampleEvery)
+			return false;
+
+		tick = 0;
+		return true;
+	}
+
+	void addKey(const QByteArray &key);
+
+	// replies are measured whether or not the command was sampled, so
+	//   this is checked first to keep the common case cheap
+	bool isBig(qint64 size) const
+	{
+		return (big.items.count() < big.capacity || size > big.items[0].value);
+	}
+
+	void addReply(const QByteArray &key, const QByteArray &command, qint64 size);
+
+	// largest first
+	QList<HotKey> hotKeys() const;
+	QList<BigKey> bigKeys() const;
+
+	// halves all counts, so keys that cool down drop out over time
+	void decay();
+
+	void clear();
+
+private:
+	class HeapItem
+	{
+	public:
+		QByteArray key;
+		QByteArray command;
+		qint64 value;
+	};
+
+	// a min-heap with a position index, so items can be updated in place
+	class Heap
+	{
+	public:
+		int capacity;
+		QVector<HeapItem> items;
+		QHash<QByteArray, int> positions;
+
+		// raises the item's value if it is present or beats the smallest
+		void offer(const QByteArray &key, const QByteArray &command, qint64 value);
+		void clear();
+
+	private:
+		void swap(int a, int b);
+		void siftUp(int at);
+		void siftDown(int at);
+	};
+
+	int sampleEvery;
+	int tick;
+	QVector<quint32> sketch; // SKETCH_DEPTH rows of SKETCH_WIDTH counters
+	Heap hot;
+	Heap big;
+
+	quint32 sketchAdd(const QByteArray &key);
+};
+
+}
+
+#endif
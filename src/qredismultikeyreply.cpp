@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredismultikeyreply.h"
+
+namespace QRedis {
+
+MultiKeyReply::MultiKeyReply() :
+	command(MultiGet),
+	total(0),
+	failed(false)
+{
+}
+
+void MultiKeyReply::reset(Command _command, int keyCount)
+{
+	command = _command;
+	values.clear();
+	total = 0;
+	failed = false;
+	firstError = Reply();
+
+	if(command == MultiGet)
+	{
+		values.reserve(keyCount);
+		for(int n = 0; n < keyCount; ++n)
+			values += QVariant();
+	}
+}
+
+bool MultiKeyReply::check(const Reply &part, int count, QVariantList *l)
+{
+	if(part.error)
+	{
+		if(!failed)
+		{
+			failed = true;
+			firstError = part;
+		}
+
+		return true;
+	}
+
+	if(command == MultiGet)
+	{
+		if(part.value.type() != QVariant::List)
+			return false;
+
+		*l = part.value.toList();
+		if(l->count() != count)
+			return false;
+
+		// nothing to keep after an error
+		if(failed)
+			l->clear();
+	}
+	else if(command == MultiDel)
+	{
+		if(part.value.type() != QVariant::LongLong)
+			return false;
+
+		total += part.value.toLongLong();
+	}
+
+	return true;
+}
+
+bool MultiKeyReply::add(const Reply &part, const QList<int> &positions)
+{
+	QVariantList l;
+	if(!check(part, positions.count(), &l))
+		return false;
+
+	for(int n = 0; n < l.count(); ++n)
+		values[positions[n]] = l[n];
+
+	return true;
+}
+
+bool MultiKeyReply::add(const Reply &part, int first, int count)
+{
+	QVariantList l;
+	if(!check(part, count, &l))
+		return false;
+
+	for(int n = 0; n < l.count(); ++n)
+		values[first + n] = l[n];
+
+	return true;
+}
+
+bool MultiKeyReply::hasError() const
+{
+	return failed;
+}
+
+Reply MultiKeyReply::result() const
+{
+	if(failed)
+		return firstError;
+
+	Reply r;
+	if(command == MultiGet)
+		r.value = values;
+	else if(command == MultiDel)
+		r.value = total;
+	else // MultiSet
+		r.value = QByteArray("OK");
+
+	return r;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISMULTIKEYREPLY_H
+#define QREDISMULTIKEYREPLY_H
+
+#include <QList>
+#include <QVariant>
+#include "qredisreply.h"
+
+namespace QRedis {
+
+// combines the replies to the parts of an MGET, MSET or DEL that was split
+//   up by key into the reply the whole command would have had. an error
+//   reply to any part becomes the combined reply
+class MultiKeyReply
+{
+public:
+	enum Command
+	{
+		MultiGet,
+		MultiSet,
+		MultiDel
+	};
+
+	MultiKeyReply();
+
+	void reset(Command command, int keyCount);
+
+	// the reply to a part made of the keys at these positions, or of count
+	//   keys starting at first. returns false if the reply doesn't fit the
+	//   command
+	bool add(const Reply &part, const QList<int> &positions);
+	bool add(const Reply &part, int first, int count);
+
+	bool hasError() const;
+
+	Reply result() const;
+
+private:
+	Command command;
+	QVariantList values;
+	qlonglong total;
+	bool failed;
+	Reply firstError;
+
+	// returns false if the reply doesn't fit. true with l empty if there
+	//   are no values to place
+	bool check(const Reply &part, int count, QVariantList *l);
+};
+
+}
+
+#endif
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredispatternmatcher.h"
+
+#include <assert.h>
+#include <string.h>
+#include <QHash>
+#include <QVector>
+
+namespace QRedis {
+
+namespace {
+
+class Token
+{
+public:
+	enum Type
+	{
+		Literal,
+		AnyChar,
+		AnyString,
+		CharClass
+	};
+
+	Type type;
+	char c;
+	QByteArray bits; // 32 bytes, one bit per char, for CharClass
+
+	Token() :
+		type(Literal),
+		c(0)
+	{
+	}
+
+	bool classContains(unsigned char ch) const
+	{
+		return (bits[ch >> 3] & (1 << (ch & 7))) != 0;
+	}
+};
+
+// same rules as redis' stringmatchlen. an unterminated class runs to the
+//   end of the pattern
+static QList<Token> tokenize(const QByteArray &pattern)
+{
+	QList<Token> out;
+
+	int at = 0;
+	while(at < pattern.size())
+	{
+		Token t;
+		char ch = pattern[at];
+
+		if(ch == '*')
+		{
+			++at;
+
+			// consecutive stars are the same as one
+			if(!out.isEmpty() && out.last().type == Token::AnyString)
+				continue;
+
+			t.type = Token::AnyString;
+		}
+		else if(ch == '?')
+		{
+			++at;
+			t.type = Token::AnyChar;
+		}
+		else if(ch == '[')
+		{
+			int pos = at + 1;
+			bool negate = false;
+			if(pos < pattern.size() && pattern[pos] == '^')
+			{
+				negate = true;
+				++pos;
+			}
+
+			t.type = Token::CharClass;
+			t.bits = QByteArray(32, 0);
+
+			while(pos < pattern.size() && pattern[pos] != ']')
+			{
+				unsigned char start = pattern[pos];
+				if(start == '\\' && pos + 1 < pattern.size())
+					start = pattern[++pos];
+
+				unsigned char end = start;
+				if(pos + 2 < pattern.size() && pattern[pos + 1] == '-' && pattern[pos + 2] != ']')
+				{
+					end = pattern[pos + 2];
+					pos += 2;
+					if(start > end)
+						qSwap(start, end);
+				}
+
+				for(int n = start; n <= end; ++n)
+					t.bits[n >> 3] = t.bits[n >> 3] | (1 << (n & 7));
+
+				++pos;
+			}
+
+			if(negate)
+			{
+				for(int n = 0; n < 32; ++n)
+					t.bits[n] = ~t.bits[n];
+			}
+
+			at = pos + 1;
+		}
+		else
+		{
+			if(ch == '\\' && at + 1 < pattern.size())
+				++at;
+
+			t.type = Token::Literal;
+			t.c = pattern[at++];
+		}
+
+		out += t;
+	}
+
+	return out;
+}
+
+}
+
+class PatternMatcher::Private
+{
+public:
+	class Node
+	{
+	public:
+		QHash<char, int> literals;
+		int anyChar;
+		int anyString;
+		QList<QPair<QByteArray, int> > classes;
+		bool loops; // reached through a star, so it eats any char itself
+		QList<int> ids;
+
+		Node() :
+			anyChar(-1),
+			anyString(-1),
+			loops(false)
+		{
+		}
+	};
+
+	QHash<QByteArray, QList<int> > exact;
+	QVector<Node> nodes;
+	QHash<int, QByteArray> patterns;
+	QHash<int, int> idNodes;
+
+	// scratch space for match(), to avoid per-call allocations
+	mutable QVector<quint32> marks;
+	mutable quint32 generation;
+	mutable QVector<int> current;
+	mutable QVector<int> next;
+
+	Private() :
+		generation(0)
+	{
+		nodes += Node();
+	}
+
+	void clear()
+	{
+		exact.clear();
+		nodes.clear();
+		nodes += Node();
+		patterns.clear();
+		idNodes.clear();
+		marks.clear();
+	}
+
+	int child(int node, const Token &t)
+	{
+		int existing = -1;
+
+		if(t.type == Token::Literal)
+			existing = nodes[node].literals.value(t.c, -1);
+		else if(t.type == Token::AnyChar)
+			existing = nodes[node].anyChar;
+		else if(t.type == Token::AnyString)
+			existing = nodes[node].anyString;
+		else // CharClass
+		{
+			const QList<QPair<QByteArray, int> > &classes = nodes[node].classes;
+			for(int n = 0; n < classes.count(); ++n)
+			{
+				if(classes[n].first == t.bits)
+				{
+					existing = classes[n].second;
+					break;
+				}
+			}
+		}
+
+		if(existing != -1)
+			return existing;
+
+		int index = nodes.count();
+		nodes += Node();
+
+		// note: nodes may have been reallocated by the append
+		Node &parent = nodes[node];
+		if(t.type == Token::Literal)
+			parent.literals.insert(t.c, index);
+		else if(t.type == Token::AnyChar)
+			parent.anyChar = index;
+		else if(t.type == Token::AnyString)
+		{
+			parent.anyString = index;
+			nodes[index].loops = true;
+		}
+		else // CharClass
+			parent.classes += qMakePair(t.bits, index);
+
+		return index;
+	}
+
+	void insert(int id, const QByteArray &pattern)
+	{
+		remove(id);
+
+		patterns.insert(id, pattern);
+
+		if(!isPattern(pattern))
+		{
+			exact[pattern] += id;
+			return;
+		}
+
+		QList<Token> tokens = tokenize(pattern);
+
+		int node = 0;
+		foreach(const Token &t, tokens)
+			node = child(node, t);
+
+		nodes[node].ids += id;
+		idNodes.insert(id, node);
+	}
+
+	void remove(int id)
+	{
+		if(!patterns.contains(id))
+			return;
+
+		QByteArray pattern = patterns.take(id);
+
+		if(idNodes.contains(id))
+		{
+			// emptied nodes are left in place. they cost nothing to walk
+			//   past, and the trie is rebuilt on clear()
+			nodes[idNodes.take(id)].ids.removeAll(id);
+		}
+		else
+		{
+			QHash<QByteArray, QList<int> >::iterator it = exact.find(pattern);
+			assert(it != exact.end());
+
+			it.value().removeAll(id);
+			if(it.value().isEmpty())
+				exact.erase(it);
+		}
+	}
+
+	// adds the node and everything reachable from it through stars
+	void addState(QVector<int> *states, int node) const
+	{
+		while(node != -1 && marks[node] != generation)
+		{
+			marks[node] = generation;
+			*states += node;
+			node = nodes[node].anyString;
+		}
+	}
+
+	QList<int> match(const QByteArray &channel) const
+	{
+		QList<int> out;
+
+		QHash<QByteArray, QList<int> >::const_iterator it = exact.find(channel);
+		if(it != exact.end())
+			out = it.value();
+
+		// only the root exists, so no patterns with wildcards
+		if(nodes.count() == 1)
+			return out;
+
+		if(marks.count() != nodes.count())
+		{
+			marks.fill(0, nodes.count());
+			generation = 0;
+		}
+
+		current.clear();
+		++generation;
+		addState(&current, 0);
+
+		const char *p = channel.constData();
+		for(int n = 0; n < channel.size() && !current.isEmpty(); ++n)
+		{
+			char ch = p[n];
+
+			next.clear();
+			++generation;
+
+			for(int i = 0; i < current.count(); ++i)
+			{
+				const Node &node = nodes[current[i]];
+
+				if(node.loops)
+					addState(&next, current[i]);
+
+				if(!node.literals.isEmpty())
+					addState(&next, node.literals.value(ch, -1));
+
+				addState(&next, node.anyChar);
+
+				for(int c = 0; c < node.classes.count(); ++c)
+				{
+					const QByteArray &bits = node.classes[c].first;
+					unsigned char uch = ch;
+					if(bits[uch >> 3] & (1 << (uch & 7)))
+						addState(&next, node.classes[c].second);
+				}
+			}
+
+			current.swap(next);
+		}
+
+		for(int i = 0; i < current.count(); ++i)
+			out += nodes[current[i]].ids;
+
+		return out;
+	}
+};
+
+PatternMatcher::PatternMatcher()
+{
+	d = new Private;
+}
+
+PatternMatcher::~PatternMatcher()
+{
+	delete d;
+}
+
+void PatternMatcher::insert(int id, const QByteArray &pattern)
+{
+	d->insert(id, pattern);
+}
+
+void PatternMatcher::remove(int id)
+{
+	d->remove(id);
+}
+
+void PatternMatcher::clear()
+{
+	d->clear();
+}
+
+QList<int> PatternMatcher::match(const QByteArray &channel) const
+{
+	return d->match(channel);
+}
+
+bool PatternMatcher::isPattern(const QByteArray &pattern)
+{
+	for(int n = 0; n < pattern.size(); ++n)
+	{
+		char c = pattern[n];
+		if(c == '*' || c == '?' || c == '[' || c == '\\')
+			return true;
+	}
+
+	return false;
+}
+
+QByteArray PatternMatcher::literalPrefix(const QByteArray &pattern)
+{
+	QByteArray out;
+
+	for(int n = 0; n < pattern.size(); ++n)
+	{
+		char c = pattern[n];
+		if(c == '*' || c == '?' || c == '[')
+			break;
+
+		if(c == '\\' && n + 1 < pattern.size())
+			c = pattern[++n];
+
+		out += c;
+	}
+
+	return out;
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISPATTERNMATCHER_H
+#define QREDISPATTERNMATCHER_H
+
+#include <QList>
+#include <QByteArray>
+
+namespace QRedis {
+
+// matches a channel against many glob patterns at once, using the same
+//   syntax as PSUBSCRIBE (*, ?, [...] and \ escapes). patterns without
+//   wildcards are looked up by hash. the rest are compiled into a trie
+//   that is walked once per channel, so the cost depends on the channel
+//   length rather than on the number of patterns. not thread-safe
+class PatternMatcher
+{
+public:
+	PatternMatcher();
+	~PatternMatcher();
+
+	void insert(int id, const QByteArray &pattern);
+	void remove(int id);
+	void clear();
+
+	// ids of all patterns matching the channel, in no particular order
+	QList<int> match(const QByteArray &channel) const;
+
+	static bool isPattern(const QByteArray &pattern);
+
+	// the part of the pattern before the first wildcard, unescaped
+	static QByteArray literalPrefix(const QByteArray &pattern);
+
+private:
+	Q_DISABLE_COPY(PatternMatcher)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisrecorder.h"
+
+#include <assert.h>
+#include <string.h>
+#include <QHash>
+#include <QFile>
+#include <QTimer>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#define RECORD_MAGIC "QRLOG1\n"
+#define RECORD_MAGIC_SIZE 7
+
+// buffered entries are handed to the writer when there are this many bytes
+//   of them, or on the next timer tick
+#define RECORD_BUFFER_SIZE 262144
+#define RECORD_FLUSH_INTERVAL 200
+
+namespace QRedis {
+
+static inline void appendVarint(QByteArray *buf, quint64 i)
+{
+	while(i >= 0x80)
+	{
+		buf->append((char)((i & 0x7f) | 0x80));
+		i >>= 7;
+	}
+
+	buf->append((char)i);
+}
+
+// owns the file once recording starts. pieces queue up in memory while the
+//   file is slow, which is preferred over stalling the event loop
+class RecordWriter : public QThread
+{
+public:
+	QFile *file;
+	QMutex m;
+	QWaitCondition cond;
+	QList<QByteArray> queue;
+	bool stopping;
+
+	RecordWriter(QFile *_file) :
+		file(_file),
+		stopping(false)
+	{
+	}
+
+	~RecordWriter()
+	{
+		// anything queued is written before the thread ends
+		m.lock();
+		stopping = true;
+		cond.wakeOne();
+		m.unlock();
+
+		wait();
+		delete file;
+	}
+
+	void write(const QByteArray &buf)
+	{
+		QMutexLocker locker(&m);
+		queue += buf;
+		cond.wakeOne();
+	}
+
+protected:
+	virtual void run()
+	{
+		m.lock();
+		while(true)
+		{
+			if(queue.isEmpty())
+			{
+				if(stopping)
+					break;
+
+				cond.wait(&m);
+				continue;
+			}
+
+			QList<QByteArray> bufs = queue;
+			queue.clear();
+
+			m.unlock();
+			foreach(const QByteArray &buf, bufs)
+				file->write(buf);
+			m.lock();
+		}
+		m.unlock();
+	}
+};
+
+class Recorder::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	Recorder *q;
+	RecordWriter *writer;
+	QByteArray buf;
+	QTimer *flushTimer;
+	QElapsedTimer time;
+	quint64 nextId;
+	QHash<quint64, qint64> sentAt; // id -> usecs
+
+	Private(Recorder *_q) :
+		QObject(_q),
+		q(_q),
+		writer(0),
+		nextId(1)
+	{
+		flushTimer = new QTimer(this);
+		connect(flushTimer, SIGNAL(timeout()), SLOT(flush()));
+		flushTimer->setSingleShot(true);
+		flushTimer->setInterval(RECORD_FLUSH_INTERVAL);
+	}
+
+	~Private()
+	{
+		if(writer)
+		{
+			flush();
+			delete writer;
+		}
+	}
+
+	bool open(const QString &fileName)
+	{
+		assert(!writer);
+
+		QFile *file = new QFile(fileName);
+		if(!file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+		{
+			delete file;
+			return false;
+		}
+
+		writer = new RecordWriter(file);
+		writer->start();
+
+		buf.reserve(RECORD_BUFFER_SIZE);
+		buf.append(RECORD_MAGIC, RECORD_MAGIC_SIZE);
+		time.start();
+		return true;
+	}
+
+	qint64 usecs() const
+	{
+		return time.nsecsElapsed() / 1000;
+	}
+
+	void entryAdded()
+	{
+		if(buf.size() >= RECORD_BUFFER_SIZE)
+			flush();
+		else if(!flushTimer->isActive())
+			flushTimer->start();
+	}
+
+private slots:
+	void flush()
+	{
+		flushTimer->stop();
+
+		if(!buf.isEmpty())
+		{
+			writer->write(buf);
+
+			// the writer holds on to the old data, so start a new buffer
+			buf = QByteArray();
+			buf.reserve(RECORD_BUFFER_SIZE);
+		}
+	}
+};
+
+Recorder::Recorder(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+Recorder::~Recorder()
+{
+	delete d;
+}
+
+bool Recorder::open(const QString &fileName)
+{
+	return d->open(fileName);
+}
+
+quint64 Recorder::recordCommand(const QList<QByteArray> &args)
+{
+	quint64 id = d->nextId++;
+	qint64 now = d->usecs();
+	d->sentAt.insert(id, now);
+
+	d->buf.append('C');
+	appendVarint(&d->buf, id);
+	appendVarint(&d->buf, now);
+	appendVarint(&d->buf, args.count());
+	foreach(const QByteArray &arg, args)
+	{
+		appendVarint(&d->buf, arg.size());
+		d->buf.append(arg);
+	}
+
+	d->entryAdded();
+	return id;
+}
+
+void Recorder::recordReply(quint64 id, quint64 size)
+{
+	qint64 latency = d->usecs() - d->sentAt.take(id);
+
+	d->buf.append('R');
+	appendVarint(&d->buf, id);
+	appendVarint(&d->buf, size);
+	appendVarint(&d->buf, latency);
+
+	d->entryAdded();
+}
+
+void Recorder::recordFailure(quint64 id)
+{
+	qint64 latency = d->usecs() - d->sentAt.take(id);
+
+	d->buf.append('F');
+	appendVarint(&d->buf, id);
+	appendVarint(&d->buf, latency);
+
+	d->entryAdded();
+}
+
+RecordReader::RecordReader(const char *_data, qint64 _size) :
+	data((const uchar *)_data),
+	size(_size),
+	pos(RECORD_MAGIC_SIZE)
+{
+	valid = (size >= RECORD_MAGIC_SIZE && memcmp(data, RECORD_MAGIC, RECORD_MAGIC_SIZE) == 0);
+}
+
+bool RecordReader::isValid() const
+{
+	return valid;
+}
+
+bool RecordReader::readVarint(quint64 *out)
+{
+	quint64 i = 0;
+	int shift = 0;
+	while(pos < size && shift < 64)
+	{
+		uchar c = data[pos++];
+		i |= (quint64)(c & 0x7f) << shift;
+		if(!(c & 0x80))
+		{
+			*out = i;
+			return true;
+		}
+
+		shift += 7;
+	}
+
+	return false;
+}
+
+bool RecordReader::next(RecordEntry *e)
+{
+	if(!valid || pos >= size)
+		return false;
+
+	char type = data[pos++];
+	*e = RecordEntry();
+
+	if(!readVarint(&e->id))
+		return false;
+
+	if(type == 'C')
+	{
+		e->type = RecordEntry::Command;
+
+		quint64 argc;
+		if(!readVarint(&e->usecs) || !readVarint(&argc))
+			return false;
+
+		for(quint64 n = 0; n < argc; ++n)
+		{
+			quint64 len;
+			if(!readVarint(&len) || len > (quint64)(size - pos))
+				return false;
+
+			e->args += QByteArray((const char *)data + pos, len);
+			pos += len;
+		}
+	}
+	else if(type == 'R')
+	{
+		e->type = RecordEntry::Reply;
+		if(!readVarint(&e->size) || !readVarint(&e->latency))
+			return false;
+	}
+	else if(type == 'F')
+	{
+		e->type = RecordEntry::Failure;
+		if(!readVarint(&e->latency))
+			return false;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+}
+
+#include "qredisrecorder.moc"
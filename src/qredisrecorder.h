@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISRECORDER_H
+#define QREDISRECORDER_H
+
+#include <QObject>
+#include <QList>
+#include <QByteArray>
+
+namespace QRedis {
+
+// a command log begins with the magic "QRLOG1\n" and is followed by
+//   records. integers are unsigned LEB128 varints. a record is one of:
+//
+//   'C' id usecs argc (size bytes)...   a command written to a connection,
+//                                       usecs since recording began
+//   'R' id size latency                 its reply, size being the bytes of
+//                                       the reply's strings, latency in usecs
+//   'F' id latency                      the command failed without a reply
+
+class RecordEntry
+{
+public:
+	enum Type
+	{
+		Command,
+		Reply,
+		Failure
+	};
+
+	Type type;
+	quint64 id;
+	quint64 usecs;
+	QList<QByteArray> args;
+	quint64 size;
+	quint64 latency;
+
+	RecordEntry() :
+		type(Command),
+		id(0),
+		usecs(0),
+		size(0),
+		latency(0)
+	{
+	}
+};
+
+// appends to a command log. entries are collected in memory and handed in
+//   large pieces to a writer thread, so the event loop never blocks on the
+//   file. Client owns one of these while recording
+class Recorder : public QObject
+{
+	Q_OBJECT
+
+public:
+	Recorder(QObject *parent = 0);
+	~Recorder();
+
+	bool open(const QString &fileName);
+
+	// returns an id for recordReply()
+	quint64 recordCommand(const QList<QByteArray> &args);
+
+	// size as counted by replyValueSize()
+	void recordReply(quint64 id, quint64 size);
+	void recordFailure(quint64 id);
+
+private:
+	Q_DISABLE_COPY(Recorder)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+// reads a command log from memory, such as a mapped file
+class RecordReader
+{
+public:
+	RecordReader(const char *data, qint64 size);
+
+	// false if the magic is missing
+	bool isValid() const;
+
+	// returns false at the end, or if the rest of the data is truncated
+	bool next(RecordEntry *e);
+
+private:
+	const uchar *data;
+	qint64 size;
+	qint64 pos;
+	bool valid;
+
+	bool readVarint(quint64 *out);
+};
+
+}
+
+#endif
@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisreplicatedclient.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qrediscommands.h"
+#include "qredisreplicatedrequest.h"
+
+// weight of each new latency sample
+#define LATENCY_ALPHA 0.2
+
+namespace QRedis {
+
+class ReplicatedClient::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Replica
+	{
+	public:
+		QString host;
+		int port;
+		Client *client;
+		double latency;
+		bool reachable;
+		bool linked;
+		qint64 offset;
+		Request *pingReq;
+		QElapsedTimer pingTime;
+		bool pingLate;
+		Request *roleReq;
+
+		Replica() :
+			port(0),
+			client(0),
+			latency(-1),
+			reachable(false),
+			linked(false),
+			offset(-1),
+			pingReq(0),
+			pingLate(false),
+			roleReq(0)
+		{
+		}
+
+		QString name() const
+		{
+			return host + ':' + QString::number(port);
+		}
+	};
+
+	ReplicatedClient *q;
+	Client *primary;
+	qint64 primaryOffset;
+	Request *primaryRoleReq;
+	QList<Replica*> replicas;
+	QHash<Request*, Replica*> probes;
+	QTimer *probeTimer;
+	qint64 maxLag;
+	bool discovery;
+	bool active;
+
+	Private(ReplicatedClient *_q) :
+		QObject(_q),
+		q(_q),
+		primaryOffset(-1),
+		primaryRoleReq(0),
+		maxLag(1048576),
+		discovery(false),
+		active(false)
+	{
+		primary = new Client(this);
+
+		probeTimer = new QTimer(this);
+		connect(probeTimer, SIGNAL(timeout()), SLOT(probe_timeout()));
+		probeTimer->setInterval(1000);
+	}
+
+	~Private()
+	{
+		delete primaryRoleReq;
+
+		QHashIterator<Request*, Replica*> it(probes);
+		while(it.hasNext())
+		{
+			it.next();
+			delete it.key();
+		}
+
+		// replicas share the primary's codec
+		foreach(Replica *r, replicas)
+			delete r->client;
+
+		qDeleteAll(replicas);
+	}
+
+	Replica *find(const QString &name) const
+	{
+		foreach(Replica *r, replicas)
+		{
+			if(r->name() == name)
+				return r;
+		}
+
+		return 0;
+	}
+
+	void connectToServer(const QString &host, int port)
+	{
+		assert(!active);
+
+		active = true;
+		primary->connectToServer(host, port);
+
+		foreach(Replica *r, replicas)
+			connectReplica(r);
+
+		probeTimer->start();
+		QMetaObject::invokeMethod(this, "probe_timeout", Qt::QueuedConnection);
+	}
+
+	void addReplica(const QString &host, int port)
+	{
+		Replica *r = new Replica;
+		r->host = host;
+		r->port = port;
+		assert(!find(r->name()));
+
+		r->client = new Client(this);
+		replicas += r;
+
+		if(active)
+			connectReplica(r);
+	}
+
+	// replicas need the same credentials and database as the primary, or
+	//   every read on them fails and falls back to the primary
+	void connectReplica(Replica *r)
+	{
+		r->client->copySetup(primary);
+		r->client->shareCodec(primary);
+		r->client->connectToServer(r->host, r->port);
+	}
+
+	bool isEligible(const Replica *r) const
+	{
+		return (r->reachable && r->linked && r->latency >= 0 && r->offset >= 0 &&
+			primaryOffset >= 0 && primaryOffset - r->offset <= maxLag);
+	}
+
+	Client *clientForCommand(const QByteArray &name) const
+	{
+		if(!isReadOnlyCommand(name))
+			return primary;
+
+		const Replica *best = 0;
+		foreach(const Replica *r, replicas)
+		{
+			if(isEligible(r) && (!best || r->latency < best->latency))
+				best = r;
+		}
+
+		return (best ? best->client : primary);
+	}
+
+private:
+	void addSample(Replica *r, double msecs)
+	{
+		if(r->latency < 0)
+			r->latency = msecs;
+		else
+			r->latency += LATENCY_ALPHA * (msecs - r->latency);
+	}
+
+	void probe(Replica *r)
+	{
+		if(r->pingReq)
+		{
+			// a probe outstanding for a whole interval counts as a slow
+			//   sample, and the replica is not used until it answers
+			addSample(r, r->pingTime.elapsed());
+			r->pingLate = true;
+			r->reachable = false;
+		}
+		else
+		{
+			r->pingReq = r->client->createRequest();
+			connect(r->pingReq, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(ping_readyRead(const QRedis::Reply &)));
+			connect(r->pingReq, SIGNAL(error()), SLOT(ping_error()));
+			probes.insert(r->pingReq, r);
+			r->pingTime.start();
+			r->pingLate = false;
+			r->pingReq->start("PING");
+		}
+
+		if(!r->roleReq)
+		{
+			r->roleReq = r->client->createRequest();
+			connect(r->roleReq, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(role_readyRead(const QRedis::Reply &)));
+			connect(r->roleReq, SIGNAL(error()), SLOT(role_error()));
+			probes.insert(r->roleReq, r);
+			r->roleReq->start("ROLE");
+		}
+	}
+
+	Replica *takeProbe(Request *req)
+	{
+		Replica *r = probes.take(req);
+		assert(r);
+
+		if(r->pingReq == req)
+			r->pingReq = 0;
+		else
+			r->roleReq = 0;
+
+		delete req;
+		return r;
+	}
+
+private slots:
+	void probe_timeout()
+	{
+		if(!primaryRoleReq)
+		{
+			primaryRoleReq = primary->createRequest();
+			connect(primaryRoleReq, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(primaryRole_readyRead(const QRedis::Reply &)));
+			connect(primaryRoleReq, SIGNAL(error()), SLOT(primaryRole_error()));
+			primaryRoleReq->start("ROLE");
+		}
+
+		foreach(Replica *r, replicas)
+			probe(r);
+	}
+
+	void ping_readyRead(const QRedis::Reply &reply)
+	{
+		Q_UNUSED(reply);
+
+		Replica *r = probes.value((Request *)sender());
+		double msecs = (double)r->pingTime.nsecsElapsed() / 1000000;
+		takeProbe((Request *)sender());
+
+		// a late reply was already counted by the timeout
+		if(!r->pingLate)
+			addSample(r, msecs);
+		r->reachable = true;
+	}
+
+	void ping_error()
+	{
+		Replica *r = takeProbe((Request *)sender());
+		r->reachable = false;
+	}
+
+	// ["slave", host, port, state, offset]
+	void role_readyRead(const QRedis::Reply &reply)
+	{
+		Replica *r = takeProbe((Request *)sender());
+
+		// only the link state is used. the replica's own offset is
+		//   sampled at a different time than the primary's, so lag is
+		//   taken from the primary's reply instead
+		QVariantList l = reply.value.toList();
+		r->linked = (l.count() >= 5 && l[0].toByteArray() == "slave" && l[3].toByteArray() == "connected");
+	}
+
+	void role_error()
+	{
+		Replica *r = takeProbe((Request *)sender());
+		r->linked = false;
+	}
+
+	// ["master", offset, [[host, port, offset], ...]]
+	void primaryRole_readyRead(const QRedis::Reply &reply)
+	{
+		delete primaryRoleReq;
+		primaryRoleReq = 0;
+
+		QVariantList l = reply.value.toList();
+		if(l.count() < 3 || l[0].toByteArray() != "master")
+		{
+			primaryOffset = -1;
+			return;
+		}
+
+		primaryOffset = l[1].toLongLong();
+
+		QHash<QString, qint64> acked;
+		QHash<int, int> portCount;
+		QHash<int, qint64> ackedByPort;
+		foreach(const QVariant &i, l[2].toList())
+		{
+			QVariantList item = i.toList();
+			if(item.count() < 3)
+				continue;
+
+			QString host = QString::fromUtf8(item[0].toByteArray());
+			int port = item[1].toInt();
+			qint64 offset = item[2].toLongLong();
+
+			acked.insert(host + ':' + QString::number(port), offset);
+			++portCount[port];
+			ackedByPort.insert(port, offset);
+
+			if(discovery && !find(host + ':' + QString::number(port)))
+				addReplica(host, port);
+		}
+
+		// the primary lists replicas by the address it sees them at,
+		//   which may not be the configured one. fall back to the port
+		//   if it is unambiguous
+		foreach(Replica *r, replicas)
+		{
+			if(acked.contains(r->name()))
+				r->offset = acked.value(r->name());
+			else if(portCount.value(r->port) == 1)
+				r->offset = ackedByPort.value(r->port);
+			else
+				r->offset = -1;
+		}
+	}
+
+	void primaryRole_error()
+	{
+		delete primaryRoleReq;
+		primaryRoleReq = 0;
+
+		// lag can't be known, so reads fall back to the primary
+		primaryOffset = -1;
+	}
+};
+
+ReplicatedClient::ReplicatedClient(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ReplicatedClient::~ReplicatedClient()
+{
+	delete d;
+}
+
+void ReplicatedClient::setProbeInterval(int msecs)
+{
+	d->probeTimer->setInterval(msecs);
+}
+
+void ReplicatedClient::setMaxLag(qint64 bytes)
+{
+	d->maxLag = bytes;
+}
+
+void ReplicatedClient::setReplicaDiscoveryEnabled(bool enabled)
+{
+	d->discovery = enabled;
+}
+
+void ReplicatedClient::connectToServer(const QString &host, int port)
+{
+	d->connectToServer(host, port);
+}
+
+void ReplicatedClient::addReplica(const QString &host, int port)
+{
+	d->addReplica(host, port);
+}
+
+QStringList ReplicatedClient::replicas() const
+{
+	QStringList out;
+	foreach(const Private::Replica *r, d->replicas)
+		out += r->name();
+	return out;
+}
+
+double ReplicatedClient::replicaLatency(const QString &replica) const
+{
+	Private::Replica *r = d->find(replica);
+	assert(r);
+
+	return r->latency;
+}
+
+Client *ReplicatedClient::primary()
+{
+	return d->primary;
+}
+
+Client *ReplicatedClient::clientForCommand(const QByteArray &name)
+{
+	return d->clientForCommand(name);
+}
+
+ReplicatedRequest *ReplicatedClient::createRequest()
+{
+	ReplicatedRequest *req = new ReplicatedRequest;
+	req->setup(this);
+	return req;
+}
+
+}
+
+#include "qredisreplicatedclient.moc"
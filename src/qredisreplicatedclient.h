@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISREPLICATEDCLIENT_H
+#define QREDISREPLICATEDCLIENT_H
+
+#include <QObject>
+#include <QStringList>
+
+namespace QRedis {
+
+class Client;
+class ReplicatedRequest;
+
+// sends writes to a primary and read-only commands to the replica with the
+//   lowest latency. replicas are probed with PING, and the latency is kept
+//   as an exponentially weighted moving average. replication lag is the
+//   difference between the primary's offset and the offset it lists as
+//   acknowledged by the replica, both from the same ROLE reply.
+//   replicas that are unreachable, not linked to the primary, or too far
+//   behind are skipped, and if no replica qualifies, reads go to the
+//   primary
+class ReplicatedClient : public QObject
+{
+	Q_OBJECT
+
+public:
+	ReplicatedClient(QObject *parent = 0);
+	~ReplicatedClient();
+
+	// default 1000
+	void setProbeInterval(int msecs);
+
+	// in bytes of replication stream. default 1048576
+	void setMaxLag(qint64 bytes);
+
+	// if enabled, replicas listed by the primary's ROLE reply are added
+	//   automatically, using the addresses the primary sees them at.
+	//   default false
+	void setReplicaDiscoveryEnabled(bool enabled);
+
+	void connectToServer(const QString &host, int port);
+	void addReplica(const QString &host, int port);
+
+	// replicas as "host:port"
+	QStringList replicas() const;
+
+	// smoothed PING round trip in msecs, or -1 if unknown
+	double replicaLatency(const QString &replica) const;
+
+	// the setup of the primary (auth, database, client name, protocol and
+	//   codec) is used for the replicas as well, so it should be set
+	//   before connectToServer()
+	Client *primary();
+	Client *clientForCommand(const QByteArray &name);
+
+	ReplicatedRequest *createRequest();
+
+private:
+	Q_DISABLE_COPY(ReplicatedClient)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
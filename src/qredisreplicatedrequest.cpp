@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisreplicatedrequest.h"
+
+#include <assert.h>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredisreplicatedclient.h"
+
+namespace QRedis {
+
+class ReplicatedRequest::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	ReplicatedRequest *q;
+	ReplicatedClient *client;
+	bool active;
+	QList<QByteArray> args;
+	Request *req;
+	bool onPrimary;
+
+	Private(ReplicatedRequest *_q) :
+		QObject(_q),
+		q(_q),
+		client(0),
+		active(false),
+		req(0),
+		onPrimary(false)
+	{
+	}
+
+	~Private()
+	{
+		delete req;
+	}
+
+	void start(const QList<QByteArray> &_args)
+	{
+		assert(!active);
+		assert(!_args.isEmpty());
+
+		active = true;
+		args = _args;
+
+		Client *c = client->clientForCommand(args[0]);
+		send(c);
+	}
+
+private:
+	void send(Client *c)
+	{
+		onPrimary = (c == client->primary());
+
+		req = c->createRequest();
+
+		// fall back to the primary rather than wait for a replica to return
+		if(!onPrimary)
+			req->setIdempotent(false);
+
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(req_error()));
+		req->start(args);
+	}
+
+private slots:
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		delete req;
+		req = 0;
+
+		active = false;
+		args.clear();
+
+		emit q->readyRead(reply);
+	}
+
+	void req_error()
+	{
+		delete req;
+		req = 0;
+
+		if(!onPrimary)
+		{
+			send(client->primary());
+			return;
+		}
+
+		active = false;
+		args.clear();
+
+		emit q->error();
+	}
+};
+
+ReplicatedRequest::ReplicatedRequest(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ReplicatedRequest::~ReplicatedRequest()
+{
+	delete d;
+}
+
+void ReplicatedRequest::set(const QByteArray &key, const QByteArray &value)
+{
+	d->start(QList<QByteArray>() << "SET" << key << value);
+}
+
+void ReplicatedRequest::get(const QByteArray &key)
+{
+	d->start(QList<QByteArray>() << "GET" << key);
+}
+
+void ReplicatedRequest::del(const QByteArray &key)
+{
+	d->start(QList<QByteArray>() << "DEL" << key);
+}
+
+void ReplicatedRequest::start(const QList<QByteArray> &args)
+{
+	d->start(args);
+}
+
+void ReplicatedRequest::setup(ReplicatedClient *client)
+{
+	d->client = client;
+}
+
+}
+
+#include "qredisreplicatedrequest.moc"
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISREPLICATEDREQUEST_H
+#define QREDISREPLICATEDREQUEST_H
+
+#include <QObject>
+
+namespace QRedis {
+
+class ReplicatedClient;
+class Reply;
+
+// a request whose connection is picked by command. a read that fails on a
+//   replica is retried once on the primary
+class ReplicatedRequest : public QObject
+{
+	Q_OBJECT
+
+public:
+	~ReplicatedRequest();
+
+	void set(const QByteArray &key, const QByteArray &value);
+	void get(const QByteArray &key);
+	void del(const QByteArray &key);
+
+	void start(const QList<QByteArray> &args);
+
+signals:
+	void readyRead(const QRedis::Reply &reply);
+	void error();
+
+private:
+	Q_DISABLE_COPY(ReplicatedRequest)
+
+	friend class ReplicatedClient;
+	ReplicatedRequest(QObject *parent = 0);
+	void setup(ReplicatedClient *client);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -33,6 +33,14 @@ class Reply
 public:
 	// may be null, string, int, or array
 	QVariant value;
+
+	// the server replied with an error, and value is its message
+	bool error;
+
+	Reply() :
+		error(false)
+	{
+	}
 };
 
 }
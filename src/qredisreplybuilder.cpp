@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisreplybuilder.h"
+
+#include <assert.h>
+#include <string.h>
+#include <hiredis/async.h>
+
+#if defined(HIREDIS_MAJOR) && HIREDIS_MAJOR >= 1
+# define QREDIS_HIREDIS_RESP3
+#endif
+
+namespace QRedis {
+
+// hiredis still looks at replies as redisReply in a few places (spontaneous
+//   errors, pubsub messages), so each object begins with a redisReply that
+//   is kept in sync. string data points into the object's QByteArray rather
+//   than into a separate malloc'd copy
+class ReplyObject
+{
+public:
+	redisReply r; // must be first
+	QByteArray str;
+	QVariantList list;
+	QVariant value;
+	quint64 size; // as replyValueSize() would count it
+
+	// for a chunked array, elements are handed over and freed as they
+	//   complete, so the array keeps no element pointers. the element in
+	//   progress is tracked so a partial reply can still be freed
+	ReplyChunkHandler *chunkHandler;
+	int expected;
+	int received;
+	void *current;
+
+	ReplyObject(int type) :
+		size(0),
+		chunkHandler(0),
+		expected(0),
+		received(0),
+		current(0)
+	{
+		memset(&r, 0, sizeof(redisReply));
+		r.type = type;
+	}
+};
+
+static void freeObject(void *obj);
+
+static ReplyObject *toObject(void *obj)
+{
+	return reinterpret_cast<ReplyObject *>(obj);
+}
+
+// link a new object into its parent, the same as the default functions do.
+//   this way a partially read reply can still be freed as a whole
+static void attach(const redisReadTask *task, ReplyObject *o)
+{
+	if(task->parent)
+	{
+		ReplyObject *parent = toObject(task->parent->obj);
+		if(parent->chunkHandler)
+			parent->current = o;
+		else
+			parent->r.element[task->idx] = &o->r;
+	}
+}
+
+// returns false if more elements are expected
+static bool completeChunked(ReplyObject *parent, ReplyObject *o)
+{
+	parent->list += o->value;
+	parent->size += o->size;
+	++(parent->received);
+
+	parent->current = 0;
+	freeObject(o);
+
+	bool last = (parent->received == parent->expected);
+	if(last || parent->list.count() >= parent->chunkHandler->chunkSize())
+	{
+		parent->chunkHandler->chunkReady(parent->list);
+		parent->list.clear();
+	}
+
+	if(!last)
+		return false;
+
+	parent->value = (qlonglong)parent->received;
+	return true;
+}
+
+// called once an object's value is final. the value is appended to the
+//   parent's list, and if that was the parent's last element then the
+//   parent is finalized as well, and so on up the stack
+static void complete(const redisReadTask *task, ReplyObject *o)
+{
+	while(task->parent)
+	{
+		ReplyObject *parent = toObject(task->parent->obj);
+
+		// note: o may be the object about to be returned to the reader.
+		//   the reader only checks it for null unless it is the root
+		if(parent->chunkHandler)
+		{
+			if(!completeChunked(parent, o))
+				return;
+
+			o = parent;
+			task = task->parent;
+			continue;
+		}
+
+		parent->list += o->value;
+		parent->size += o->size;
+		if(parent->list.count() < (int)parent->r.elements)
+			return;
+
+		parent->value = parent->list;
+		parent->list.clear();
+
+		o = parent;
+		task = task->parent;
+	}
+}
+
+// the reply being parsed belongs to the oldest pending callback, except
+//   for pubsub messages
+static ReplyChunkHandler *chunkHandlerFor(const redisReadTask *task)
+{
+	ReplyBuilderContext *bc = (ReplyBuilderContext *)task->privdata;
+	if(!bc || bc->chunkHandlers.isEmpty())
+		return 0;
+
+	redisAsyncContext *ac = bc->ac;
+	if((ac->c.flags & REDIS_SUBSCRIBED) || !ac->replies.head)
+		return 0;
+
+	return bc->chunkHandlers.value(ac->replies.head->privdata);
+}
+
+static void *createString(const redisReadTask *task, char *str, size_t len)
+{
+	ReplyObject *o = new ReplyObject(task->type);
+
+#ifdef REDIS_REPLY_VERB
+	// verbatim strings are prefixed with a 3 character format and a colon
+	if(task->type == REDIS_REPLY_VERB && len >= 4)
+	{
+		memcpy(o->r.vtype, str, 3);
+		str += 4;
+		len -= 4;
+	}
+#endif
+
+	o->str = QByteArray(str, (int)len);
+	o->r.str = (char *)o->str.constData();
+	o->r.len = len;
+	o->value = o->str;
+	o->size = len;
+
+	attach(task, o);
+	complete(task, o);
+	return o;
+}
+
+#ifdef QREDIS_HIREDIS_RESP3
+static void *createArray(const redisReadTask *task, size_t elements)
+#else
+static void *createArray(const redisReadTask *task, int elements)
+#endif
+{
+	ReplyObject *o = new ReplyObject(task->type);
+
+	if(!task->parent && elements > 0)
+		o->chunkHandler = chunkHandlerFor(task);
+
+	if(o->chunkHandler)
+	{
+		// hiredis sees an empty array
+		o->expected = (int)elements;
+		attach(task, o);
+		return o;
+	}
+
+	if(elements > 0)
+	{
+		o->r.element = (redisReply **)calloc(elements, sizeof(redisReply *));
+		if(!o->r.element)
+		{
+			delete o;
+			return 0;
+		}
+
+		o->list.reserve((int)elements);
+	}
+
+	o->r.elements = elements;
+
+	attach(task, o);
+
+	// empty arrays are complete right away. otherwise we finish when the
+	//   last element arrives
+	if(elements == 0)
+	{
+		o->value = QVariantList();
+		complete(task, o);
+	}
+
+	return o;
+}
+
+static void *createInteger(const redisReadTask *task, long long value)
+{
+	ReplyObject *o = new ReplyObject(REDIS_REPLY_INTEGER);
+	o->r.integer = value;
+	o->value = (qlonglong)value;
+	o->size = 8;
+
+	attach(task, o);
+	complete(task, o);
+	return o;
+}
+
+static void *createNil(const redisReadTask *task)
+{
+	ReplyObject *o = new ReplyObject(REDIS_REPLY_NIL);
+
+	attach(task, o);
+	complete(task, o);
+	return o;
+}
+
+#ifdef QREDIS_HIREDIS_RESP3
+static void *createDouble(const redisReadTask *task, double value, char *str, size_t len)
+{
+	ReplyObject *o = new ReplyObject(REDIS_REPLY_DOUBLE);
+	o->str = QByteArray(str, (int)len);
+	o->r.str = (char *)o->str.constData();
+	o->r.len = len;
+	o->r.dval = value;
+	o->value = value;
+	o->size = 8;
+
+	attach(task, o);
+	complete(task, o);
+	return o;
+}
+
+static void *createBool(const redisReadTask *task, int value)
+{
+	ReplyObject *o = new ReplyObject(REDIS_REPLY_BOOL);
+	o->r.integer = value != 0;
+	o->value = (value != 0);
+	o->size = 8;
+
+	attach(task, o);
+	complete(task, o);
+	return o;
+}
+#endif
+
+static void freeObject(void *obj)
+{
+	ReplyObject *o = toObject(obj);
+
+	if(o->current)
+		freeObject(o->current);
+
+	if(o->r.element)
+	{
+		for(size_t n = 0; n < o->r.elements; ++n)
+		{
+			if(o->r.element[n])
+				freeObject(o->r.element[n]);
+		}
+
+		free(o->r.element);
+	}
+
+	delete o;
+}
+
+class ReplyFunctions
+{
+public:
+	redisReplyObjectFunctions fn;
+
+	ReplyFunctions()
+	{
+		memset(&fn, 0, sizeof(redisReplyObjectFunctions));
+		fn.createString = createString;
+		fn.createArray = createArray;
+		fn.createInteger = createInteger;
+		fn.createNil = createNil;
+#ifdef QREDIS_HIREDIS_RESP3
+		fn.createDouble = createDouble;
+		fn.createBool = createBool;
+#endif
+		fn.freeObject = freeObject;
+	}
+};
+
+Q_GLOBAL_STATIC(ReplyFunctions, g_replyFunctions)
+
+void installReplyBuilder(redisAsyncContext *ac, ReplyBuilderContext *bc)
+{
+	assert(ac->c.reader);
+
+	ac->c.reader->fn = &(g_replyFunctions()->fn);
+
+	if(bc)
+	{
+		bc->ac = ac;
+		ac->c.reader->privdata = bc;
+	}
+}
+
+QVariant replyBuilderValue(const void *reply)
+{
+	return reinterpret_cast<const ReplyObject *>(reply)->value;
+}
+
+quint64 replyBuilderSize(const void *reply)
+{
+	return reinterpret_cast<const ReplyObject *>(reply)->size;
+}
+
+bool replyBuilderIsError(const void *reply)
+{
+	return (reinterpret_cast<const ReplyObject *>(reply)->r.type == REDIS_REPLY_ERROR);
+}
+
+int replyBuilderElementCount(const void *reply)
+{
+	return (int)reinterpret_cast<const ReplyObject *>(reply)->r.elements;
+}
+
+const void *replyBuilderElement(const void *reply, int index)
+{
+	const ReplyObject *o = reinterpret_cast<const ReplyObject *>(reply);
+	assert(index >= 0 && index < (int)o->r.elements);
+
+	return o->r.element[index];
+}
+
+quint64 replyValueSize(const QVariant &value)
+{
+	if(value.type() == QVariant::ByteArray)
+		return value.toByteArray().size();
+	else if(value.type() == QVariant::List)
+	{
+		quint64 total = 0;
+		foreach(const QVariant &i, value.toList())
+			total += replyValueSize(i);
+		return total;
+	}
+	else if(value.isNull())
+		return 0;
+	else
+		return 8;
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISREPLYBUILDER_H
+#define QREDISREPLYBUILDER_H
+
+#include <QVariant>
+#include <QHash>
+
+extern "C" {
+struct redisAsyncContext;
+}
+
+namespace QRedis {
+
+// receives the elements of a top-level array reply as they are parsed,
+//   instead of them being collected. the reply's own value becomes the
+//   element count
+class ReplyChunkHandler
+{
+public:
+	virtual ~ReplyChunkHandler() {}
+
+	virtual int chunkSize() const = 0;
+
+	// called from within hiredis' read handling
+	virtual void chunkReady(const QVariantList &elements) = 0;
+};
+
+// per-context state of the builder. chunk handlers are keyed by the
+//   privdata of the command whose reply they take
+class ReplyBuilderContext
+{
+public:
+	redisAsyncContext *ac;
+	QHash<const void*, ReplyChunkHandler*> chunkHandlers;
+
+	ReplyBuilderContext() :
+		ac(0)
+	{
+	}
+};
+
+// replaces the reply object functions of the context's reader, so that
+//   replies are built as Qt values while hiredis parses them
+void installReplyBuilder(redisAsyncContext *ac, ReplyBuilderContext *bc = 0);
+
+// returns the value of a reply object created by the builder
+QVariant replyBuilderValue(const void *reply);
+
+// the same count as replyValueSize(), kept while the reply was parsed.
+//   this is the size on the wire, before any decoding
+quint64 replyBuilderSize(const void *reply);
+
+bool replyBuilderIsError(const void *reply);
+
+// elements of an array reply. a chunked array has none
+int replyBuilderElementCount(const void *reply);
+const void *replyBuilderElement(const void *reply, int index);
+
+// bytes of the strings in a reply value, counting 8 for each number
+quint64 replyValueSize(const QVariant &value);
+
+}
+
+#endif
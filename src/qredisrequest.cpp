@@ -26,42 +26,32 @@
 #include <assert.h>
 #include <hiredis/async.h>
 #include <QVariant>
+#include <QPointer>
 #include "qredisclient.h"
+#include "qredisconnection.h"
 #include "qredisreply.h"
+#include "qredisreplybuilder.h"
+#include "qrediscommands.h"
 
 //#define QREDIS_DEBUG
 
 namespace QRedis {
 
-static QVariant redisReplyToVariant(const redisReply *reply)
+// identical argument lists produce identical ids
+static QByteArray flightIdForArgs(const QList<QByteArray> &args)
 {
-	if(reply->type == REDIS_REPLY_STATUS || reply->type == REDIS_REPLY_ERROR || reply->type == REDIS_REPLY_STRING)
+	QByteArray out;
+	foreach(const QByteArray &arg, args)
 	{
-		return QByteArray(reply->str, reply->len);
-	}
-	else if(reply->type == REDIS_REPLY_INTEGER)
-	{
-		return reply->integer;
-	}
-	else if(reply->type == REDIS_REPLY_NIL)
-	{
-		return QVariant();
-	}
-	else if(reply->type == REDIS_REPLY_ARRAY)
-	{
-		QVariantList out;
-		for(int n = 0; n < (int)reply->elements; ++n)
-			out += redisReplyToVariant(reply->element[n]);
-		return out;
-	}
-	else
-	{
-		// unknown type!
-		assert(0);
+		out += QByteArray::number(arg.size());
+		out += ':';
+		out += arg;
 	}
+
+	return out;
 }
 
-class Request::Private : public QObject
+class Request::Private : public QObject, public ReplyChunkHandler, public LeaseWaiter
 {
 	Q_OBJECT
 
@@ -70,29 +60,176 @@ public:
 	{
 	public:
 		Private *rp;
+		bool streaming;
+		int refs; // one per subscribed channel, otherwise one
 	};
 
 	Request *q;
 	Client *client;
+	Priority priority;
+	Connection *connection;
 	bool active;
 	bool streaming;
 	CommandItem *commandItem;
+	int queueId;
 	QList<QByteArray> args;
 	Reply reply;
+	QByteArray flightId;
+	Private *leader;
+	QList<Private*> followers;
+	bool leased;
+	bool waitingLease;
+	bool idempotentSet;
+	bool idempotent;
+	int attempts;
+	bool replaying;
+	int chunkElements;
+	QList<QVariantList> pendingChunks;
+	bool chunksScheduled;
 
 	Private(Request *_q) :
 		QObject(_q),
 		q(_q),
+		priority(NormalPriority),
+		connection(0),
 		active(false),
 		streaming(false),
-		commandItem(0)
+		commandItem(0),
+		queueId(-1),
+		leader(0),
+		leased(false),
+		waitingLease(false),
+		idempotentSet(false),
+		idempotent(false),
+		attempts(0),
+		replaying(false),
+		chunkElements(0),
+		chunksScheduled(false)
 	{
 	}
 
 	~Private()
 	{
+		cancel();
+	}
+
+	void cancel()
+	{
+		if(!active)
+			return;
+
+		active = false;
+
+		if(leader)
+		{
+			leader->followers.removeAll(this);
+			leader = 0;
+		}
+
+		if(waitingLease)
+		{
+			client->cancelLease(this);
+			waitingLease = false;
+		}
+
+		if(connection)
+			disconnect(connection, SIGNAL(connected()), this, SLOT(client_connected()));
+
+		if(replaying)
+		{
+			client->cancelReplay(q);
+			replaying = false;
+
+			if(!followers.isEmpty())
+			{
+				Private *f = takeOverFlight();
+				f->attempts = attempts;
+				f->replaying = true;
+				client->queueReplay(connection, f->q);
+			}
+		}
+
+		pendingChunks.clear();
+
+		// whether a command of ours is on the wire
+		bool sent = false;
+
 		if(commandItem)
-			commandItem->rp = 0;
+		{
+			if(chunkElements > 0)
+				connection->removeChunkHandler(commandItem);
+
+			if(!followers.isEmpty())
+			{
+				Private *f = takeOverFlight();
+				f->commandItem = commandItem;
+				f->queueId = queueId;
+				commandItem->rp = f;
+				client->setFlightLeader(flightId, f->q);
+			}
+			else
+			{
+				if(!flightId.isEmpty())
+					client->removeFlightLeader(flightId, q);
+
+				if(connection->cancel(queueId))
+				{
+					delete commandItem;
+					client->commandUnsent();
+				}
+				else
+				{
+					commandItem->rp = 0;
+					sent = true;
+
+					// the reply won't reach us
+					connection->recordReply(queueId, 0);
+
+					if(streaming)
+						unsubscribe();
+				}
+			}
+
+			commandItem = 0;
+		}
+
+		if(leased)
+		{
+			leased = false;
+
+			// a connection whose command was abandoned may still be blocked on
+			//   the server, so it can't be reused
+			client->releaseConnection(connection, !sent);
+		}
+
+		streaming = false;
+	}
+
+	// hands the pending command over to a follower, so the others still get
+	//   the reply
+	Private *takeOverFlight()
+	{
+		Private *f = followers.takeFirst();
+		f->leader = 0;
+		f->followers = followers;
+		foreach(Private *other, f->followers)
+			other->leader = f;
+		followers.clear();
+
+		return f;
+	}
+
+	// the server's unsubscribe replies are delivered to our command item,
+	//   which is freed after the last one
+	void unsubscribe()
+	{
+		QList<QByteArray> unsubArgs = args;
+		if(qstrnicmp(args[0].data(), "PSUBSCRIBE", 10) == 0)
+			unsubArgs[0] = "PUNSUBSCRIBE";
+		else
+			unsubArgs[0] = "UNSUBSCRIBE";
+
+		connection->enqueue(unsubArgs, 0, 0);
 	}
 
 	void start(const QList<QByteArray> &_args)
@@ -105,47 +242,115 @@ public:
 
 		active = true;
 		args = _args;
+		client->encodeArgs(&args);
+		connection = client->connectionForPriority(priority);
+		flightId.clear();
+		attempts = 0;
+
+		if(!idempotentSet)
+			idempotent = isReadOnlyCommand(args[0]);
+
+		client->retryDeposit();
+
+		// chunks can't be shared or replayed
+		if(!idempotentSet && chunkElements > 0)
+			idempotent = false;
 
+		if(client->isSingleFlightEnabled() && isReadOnlyCommand(args[0]) && chunkElements == 0)
+		{
+			// don't let a request wait on a flight in a slower lane
+			flightId = QByteArray::number(priority) + '/' + flightIdForArgs(args);
+
+			Request *req = client->flightLeader(flightId);
+			if(req)
+			{
+				leader = req->d;
+				leader->followers += this;
+				client->flightCollapsed();
+				return;
+			}
+		}
+
+		if(isBlockingCommand(args))
+		{
+			Connection *conn = client->leaseConnection(this);
+			if(!conn)
+			{
+				// leaseReady() will be called
+				waitingLease = true;
+				return;
+			}
+
+			connection = conn;
+			leased = true;
+		}
+
+		trySend();
+	}
+
+	virtual void leaseReady(Connection *conn)
+	{
+		waitingLease = false;
+		connection = conn;
+		leased = true;
+
+		trySend();
+	}
+
+	void replay()
+	{
+		replaying = false;
+
+		if(!sendCommand())
+			trySend();
+	}
+
+	void trySend()
+	{
 		if(!sendCommand())
 		{
 			// wait until client is connected
-			connect(client, SIGNAL(connected()), SLOT(client_connected()));
+			connect(connection, SIGNAL(connected()), SLOT(client_connected()));
+		}
+	}
+
+	void releaseLease()
+	{
+		if(leased)
+		{
+			leased = false;
+			client->releaseConnection(connection, true);
 		}
 	}
 
 	// return false if ac not available (between reconnects)
 	bool sendCommand()
 	{
-		redisAsyncContext *ac = client->getContext();
+		redisAsyncContext *ac = connection->context();
 		if(!ac)
 			return false;
 
-		const char **argv = (const char **)malloc(args.count() * sizeof(char *));
-		size_t *argvlen = (size_t *)malloc(args.count() * sizeof(size_t));
-
-		for(int n = 0; n < args.count(); ++n)
-		{
-			const QByteArray &arg = args[n];
-			assert(!arg.isNull());
-			argv[n] = arg.data();
-			argvlen[n] = arg.length();
-		}
-
 		commandItem = new CommandItem;
 		commandItem->rp = this;
+		commandItem->streaming = false;
+		commandItem->refs = 1;
 
 		if(qstrnicmp(args[0].data(), "SUBSCRIBE", 9) == 0 ||
 			qstrnicmp(args[0].data(), "PSUBSCRIBE", 10) == 0)
 		{
 			streaming = true;
+			commandItem->streaming = true;
+			commandItem->refs = args.count() - 1;
 		}
 
-		int ret = redisAsyncCommandArgv(ac, cb_command, commandItem, args.count(), argv, argvlen);
-		free(argvlen);
-		free(argv);
+		if(chunkElements > 0 && !streaming)
+			connection->setChunkHandler(commandItem, this);
 
-		if(ret == REDIS_ERR)
-			QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+		queueId = connection->enqueue(args, cb_command, commandItem);
+		client->sampleCommand(args);
+
+		if(!flightId.isEmpty())
+			client->setFlightLeader(flightId, q);
 
 		return true;
 	}
@@ -157,48 +362,164 @@ private:
 
 		CommandItem *ci = (CommandItem *)privdata;
 		Private *rp = ci->rp;
-		if(!rp)
+
+		// a subscription stays registered with hiredis until each of its
+		//   channels is unsubscribed or the context goes away
+		if(!ci->streaming || !reply || isUnsubscribeReply(reply))
 		{
-			delete ci;
-			return;
+			if(--(ci->refs) == 0)
+			{
+				if(rp)
+				{
+					if(rp->chunkElements > 0)
+						rp->connection->removeChunkHandler(ci);
+
+					rp->commandItem = 0;
+				}
+
+				delete ci;
+			}
 		}
 
-		rp->cb_command(reply);
+		if(rp)
+			rp->cb_command(reply);
+	}
+
+	virtual int chunkSize() const
+	{
+		return chunkElements;
+	}
+
+	// hiredis is mid-parse, so delivery is queued. at most one socket
+	//   read worth of elements piles up
+	virtual void chunkReady(const QVariantList &elements)
+	{
+		pendingChunks += elements;
+
+		if(!chunksScheduled)
+		{
+			chunksScheduled = true;
+			QMetaObject::invokeMethod(this, "deliverChunks", Qt::QueuedConnection);
+		}
+	}
+
+	static bool isUnsubscribeReply(void *reply)
+	{
+		QVariantList l = replyBuilderValue(reply).toList();
+		if(l.isEmpty())
+			return false;
+
+		QByteArray type = l[0].toByteArray();
+		return (type == "unsubscribe" || type == "punsubscribe");
 	}
 
 	void cb_command(void *_reply)
 	{
-		if(!streaming || !_reply)
+		if(streaming && !_reply && commandItem)
 		{
-			// remove callback association if not a streaming command, or we received
-			//   an error while streaming
-			delete commandItem;
+			// an error while streaming. the remaining channels are released
+			//   by the static callback
+			commandItem->rp = 0;
 			commandItem = 0;
 		}
 
+		if(!flightId.isEmpty())
+			client->removeFlightLeader(flightId, q);
+
+		if(!_reply)
+			connection->recordReply(queueId, 0);
+
+		// cut off by a disconnect. send it again after reconnecting, with
+		//   any followers still waiting on it
+		if(!_reply && !streaming && idempotent && client->retryWithdraw(attempts))
+		{
+			++attempts;
+			replaying = true;
+			client->queueReplay(connection, q);
+			return;
+		}
+
 		if(_reply)
 		{
-			reply.value = redisReplyToVariant((const redisReply *)_reply);
+			reply.value = replyBuilderValue(_reply);
+			reply.error = (((redisReply *)_reply)->type == REDIS_REPLY_ERROR);
+
+			// only the first reply of a subscription is recorded
+			connection->recordReply(queueId, _reply);
+
+			// every reply is measured, using its size before decoding
+			if(!streaming)
+				client->sampleReply(args, _reply);
+
+			if(chunkElements == 0)
+				client->decodeReply(args, &reply.value);
+
+			// followers share the reply data
+			foreach(Private *f, followers)
+			{
+				f->leader = 0;
+				f->reply = reply;
+				QMetaObject::invokeMethod(f, "handleReply", Qt::QueuedConnection);
+			}
 
 			QMetaObject::invokeMethod(this, "handleReply", Qt::QueuedConnection);
 		}
 		else
+		{
+			// give a failed lease back now rather than from the queued
+			//   handler, as the client may be going away
+			if(leased)
+			{
+				leased = false;
+				client->releaseConnection(connection, false);
+			}
+
+			foreach(Private *f, followers)
+			{
+				f->leader = 0;
+				QMetaObject::invokeMethod(f, "handleError", Qt::QueuedConnection);
+			}
+
 			QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+		}
+
+		followers.clear();
 	}
 
 private slots:
 	void client_connected()
 	{
-		disconnect(client, SIGNAL(connected()), this, SLOT(client_connected()));
+		disconnect(connection, SIGNAL(connected()), this, SLOT(client_connected()));
 
 		if(!sendCommand())
 			handleError();
 	}
 
+	void deliverChunks()
+	{
+		chunksScheduled = false;
+
+		QPointer<QObject> self = this;
+		while(active && !pendingChunks.isEmpty())
+		{
+			QVariantList elements = pendingChunks.takeFirst();
+			emit q->chunkReady(elements);
+			if(!self)
+				return;
+		}
+	}
+
 	void handleReply()
 	{
+		// cancelled
+		if(!active)
+			return;
+
 		if(!streaming)
+		{
 			active = false;
+			releaseLease();
+		}
 
 		// emit a copy from the stack, so the request is deletable
 		Reply r = reply;
@@ -212,7 +533,11 @@ private slots:
 
 	void handleError()
 	{
+		if(!active)
+			return;
+
 		active = false;
+		releaseLease();
 		emit q->error();
 	}
 };
@@ -228,6 +553,34 @@ Request::~Request()
 	delete d;
 }
 
+void Request::setPriority(Priority priority)
+{
+	assert(!d->active);
+
+	d->priority = priority;
+}
+
+void Request::cancel()
+{
+	d->cancel();
+}
+
+void Request::setChunkSize(int elements)
+{
+	assert(!d->active);
+	assert(elements >= 0);
+
+	d->chunkElements = elements;
+}
+
+void Request::setIdempotent(bool idempotent)
+{
+	assert(!d->active);
+
+	d->idempotentSet = true;
+	d->idempotent = idempotent;
+}
+
 void Request::set(const QByteArray &key, const QByteArray &value)
 {
 	d->start(QList<QByteArray>() << "SET" << key << value);
@@ -283,6 +636,11 @@ void Request::setup(Client *client)
 	d->client = client;
 }
 
+void Request::replay()
+{
+	d->replay();
+}
+
 }
 
 #include "qredisrequest.moc"
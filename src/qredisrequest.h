@@ -25,6 +25,7 @@
 #define QREDISREQUEST_H
 
 #include <QObject>
+#include <QVariant>
 
 namespace QRedis {
 
@@ -36,8 +37,30 @@ class Request : public QObject
 	Q_OBJECT
 
 public:
+	enum Priority
+	{
+		HighPriority,
+		NormalPriority,
+		LowPriority
+	};
+
 	~Request();
 
+	// selects the connection lane, if the client has priority lanes
+	//   enabled. default NormalPriority
+	void setPriority(Priority priority);
+
+	// if non-zero, the elements of an array reply are emitted through
+	//   chunkReady() in groups of up to this many as they are parsed, so
+	//   the whole reply is never held in memory. the value given to
+	//   readyRead() is then the element count. such requests are not
+	//   single-flighted or idempotent by default. default 0
+	void setChunkSize(int elements);
+
+	// whether the command may be sent again if the connection drops before
+	//   the reply arrives. default true for read-only commands
+	void setIdempotent(bool idempotent);
+
 	void set(const QByteArray &key, const QByteArray &value);
 	void get(const QByteArray &key);
 	void del(const QByteArray &key);
@@ -55,7 +78,13 @@ public:
 
 	void start(const QList<QByteArray> &args);
 
+	// stops the request without emitting anything. a command not yet
+	//   written to the connection is dropped, and a subscription is
+	//   unsubscribed. deleting the request does the same
+	void cancel();
+
 signals:
+	void chunkReady(const QVariantList &elements);
 	void readyRead(const QRedis::Reply &reply);
 	void error();
 
@@ -65,6 +94,7 @@ private:
 	friend class Client;
 	Request(QObject *parent = 0);
 	void setup(Client *client);
+	void replay();
 
 	class Private;
 	friend class Private;
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisscanner.h"
+
+#include <assert.h>
+#include <QSet>
+#include <QQueue>
+#include <QPointer>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+
+namespace QRedis {
+
+class Scanner::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	Scanner *q;
+	Client *client;
+	QByteArray match;
+	int count;
+	QByteArray type;
+	int dedupWindow;
+	bool active;
+	QByteArray command;
+	QByteArray key;
+	bool pairs;
+	Request *req;
+	QSet<QByteArray> seen;
+	QQueue<QByteArray> seenOrder;
+
+	Private(Scanner *_q, Client *_client) :
+		QObject(_q),
+		q(_q),
+		client(_client),
+		count(0),
+		dedupWindow(10000),
+		active(false),
+		pairs(false),
+		req(0)
+	{
+	}
+
+	~Private()
+	{
+		delete req;
+	}
+
+	void start(const QByteArray &_command, const QByteArray &_key = QByteArray())
+	{
+		assert(!active);
+
+		active = true;
+		command = _command;
+		key = _key;
+		pairs = (command == "HSCAN" || command == "ZSCAN");
+		seen.clear();
+		seenOrder.clear();
+
+		requestPage("0");
+	}
+
+	void stop()
+	{
+		delete req;
+		req = 0;
+
+		active = false;
+	}
+
+private:
+	void requestPage(const QByteArray &cursor)
+	{
+		QList<QByteArray> args;
+		args += command;
+		if(!key.isNull())
+			args += key;
+		args += cursor;
+		if(!match.isEmpty())
+			args << "MATCH" << match;
+		if(count > 0)
+			args << "COUNT" << QByteArray::number(count);
+		if(!type.isEmpty() && command == "SCAN")
+			args << "TYPE" << type;
+
+		req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(req_error()));
+		req->start(args);
+	}
+
+	// returns true if the item hasn't been delivered recently
+	bool remember(const QByteArray &item)
+	{
+		if(dedupWindow <= 0)
+			return true;
+
+		if(seen.contains(item))
+			return false;
+
+		seen += item;
+		seenOrder.enqueue(item);
+		if(seenOrder.count() > dedupWindow)
+			seen.remove(seenOrder.dequeue());
+
+		return true;
+	}
+
+private slots:
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		delete req;
+		req = 0;
+
+		QVariantList l = reply.value.toList();
+		if(reply.value.type() != QVariant::List || l.count() != 2 || l[1].type() != QVariant::List)
+		{
+			active = false;
+			emit q->error();
+			return;
+		}
+
+		QByteArray cursor = l[0].toByteArray();
+		QVariantList page = l[1].toList();
+
+		// keep a page in flight while this one is handled
+		bool done = (cursor == "0");
+		if(!done)
+			requestPage(cursor);
+		else
+			active = false;
+
+		QList<QByteArray> items;
+		items.reserve(page.count());
+		int step = pairs ? 2 : 1;
+		for(int n = 0; n + step - 1 < page.count(); n += step)
+		{
+			QByteArray item = page[n].toByteArray();
+			if(!remember(item))
+				continue;
+
+			items += item;
+			if(pairs)
+				items += page[n + 1].toByteArray();
+		}
+
+		QPointer<QObject> self = this;
+
+		if(!items.isEmpty())
+		{
+			emit q->itemsReady(items);
+			if(!self)
+				return;
+		}
+
+		if(done)
+			emit q->finished();
+	}
+
+	void req_error()
+	{
+		delete req;
+		req = 0;
+
+		active = false;
+		emit q->error();
+	}
+};
+
+Scanner::Scanner(Client *client, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, client);
+}
+
+Scanner::~Scanner()
+{
+	delete d;
+}
+
+void Scanner::setMatch(const QByteArray &pattern)
+{
+	d->match = pattern;
+}
+
+void Scanner::setCount(int count)
+{
+	d->count = count;
+}
+
+void Scanner::setType(const QByteArray &type)
+{
+	d->type = type;
+}
+
+void Scanner::setDedupWindow(int items)
+{
+	d->dedupWindow = items;
+}
+
+void Scanner::scan()
+{
+	d->start("SCAN");
+}
+
+void Scanner::hscan(const QByteArray &key)
+{
+	d->start("HSCAN", key);
+}
+
+void Scanner::sscan(const QByteArray &key)
+{
+	d->start("SSCAN", key);
+}
+
+void Scanner::zscan(const QByteArray &key)
+{
+	d->start("ZSCAN", key);
+}
+
+void Scanner::stop()
+{
+	d->stop();
+}
+
+}
+
+#include "qredisscanner.moc"
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISSCANNER_H
+#define QREDISSCANNER_H
+
+#include <QObject>
+
+namespace QRedis {
+
+class Client;
+
+// walks a SCAN-family cursor. the next page is requested as soon as a page
+//   arrives, before its items are delivered, so processing overlaps with
+//   the next round trip
+class Scanner : public QObject
+{
+	Q_OBJECT
+
+public:
+	Scanner(Client *client, QObject *parent = 0);
+	~Scanner();
+
+	void setMatch(const QByteArray &pattern);
+
+	// a hint for the server's page size. default 0, meaning the server
+	//   default
+	void setCount(int count);
+
+	// key type filter, for scan() only. requires Redis 6
+	void setType(const QByteArray &type);
+
+	// SCAN may return an item more than once. this many of the most
+	//   recently delivered items are remembered and not delivered again.
+	//   zero disables. default 10000
+	void setDedupWindow(int items);
+
+	void scan();
+	void hscan(const QByteArray &key);
+	void sscan(const QByteArray &key);
+	void zscan(const QByteArray &key);
+
+	void stop();
+
+signals:
+	// for HSCAN and ZSCAN, items alternate between field (or member) and
+	//   value (or score)
+	void itemsReady(const QList<QByteArray> &items);
+	void finished();
+	void error();
+
+private:
+	Q_DISABLE_COPY(Scanner)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisshardedclient.h"
+
+#include <assert.h>
+#include <QMap>
+#include <QCryptographicHash>
+#include "qredisclient.h"
+#include "qredisshardedrequest.h"
+
+namespace QRedis {
+
+// the same point derivation as libketama: each md5 digest yields four
+//   little-endian 32-bit points
+static quint32 ketamaPoint(const QByteArray &digest, int n)
+{
+	const uchar *p = (const uchar *)digest.data() + (n * 4);
+	return ((quint32)p[3] << 24) | ((quint32)p[2] << 16) | ((quint32)p[1] << 8) | (quint32)p[0];
+}
+
+static QByteArray hashTag(const QByteArray &key)
+{
+	int start = key.indexOf('{');
+	if(start == -1)
+		return key;
+
+	int end = key.indexOf('}', start + 1);
+	if(end == -1 || end == start + 1)
+		return key;
+
+	return key.mid(start + 1, end - start - 1);
+}
+
+class ShardedClient::Private
+{
+public:
+	class Shard
+	{
+	public:
+		QString name;
+		QString host;
+		int port;
+		int weight;
+		bool down;
+		Client *client;
+	};
+
+	ShardedClient *q;
+	int virtualNodes;
+	bool hashTags;
+	QList<Shard> shards;
+	QMap<quint32, int> ring;
+	Client *setup; // never connected. holds the settings shards copy
+
+	Private(ShardedClient *_q) :
+		q(_q),
+		virtualNodes(160),
+		hashTags(false)
+	{
+		setup = new Client;
+	}
+
+	~Private()
+	{
+		// shards share the codec owned by the setup client
+		foreach(const Shard &s, shards)
+			delete s.client;
+
+		delete setup;
+	}
+
+	int indexOf(const QString &name) const
+	{
+		for(int n = 0; n < shards.count(); ++n)
+		{
+			if(shards[n].name == name)
+				return n;
+		}
+
+		return -1;
+	}
+
+	void addShard(const QString &name, const QString &host, int port, int weight)
+	{
+		assert(indexOf(name) == -1);
+		assert(weight > 0);
+
+		Shard s;
+		s.name = name;
+		s.host = host;
+		s.port = port;
+		s.weight = weight;
+		s.down = false;
+		s.client = 0;
+		shards += s;
+
+		int index = shards.count() - 1;
+		int points = virtualNodes * weight;
+		for(int n = 0; n < points / 4; ++n)
+		{
+			QByteArray digest = QCryptographicHash::hash(name.toUtf8() + '-' + QByteArray::number(n), QCryptographicHash::Md5);
+			for(int k = 0; k < 4; ++k)
+			{
+				// on the rare collision, the first shard keeps the point
+				quint32 point = ketamaPoint(digest, k);
+				if(!ring.contains(point))
+					ring.insert(point, index);
+			}
+		}
+	}
+
+	int shardIndexForKey(const QByteArray &key) const
+	{
+		if(ring.isEmpty())
+			return -1;
+
+		QByteArray digest = QCryptographicHash::hash(hashTags ? hashTag(key) : key, QCryptographicHash::Md5);
+		quint32 h = ketamaPoint(digest, 0);
+
+		// walk clockwise to the first point owned by a live shard. points
+		//   of down shards are skipped rather than removed, so that only
+		//   their keys move
+		QMap<quint32, int>::const_iterator it = ring.lowerBound(h);
+		for(int n = 0; n < ring.count(); ++n)
+		{
+			if(it == ring.constEnd())
+				it = ring.constBegin();
+
+			if(!shards[it.value()].down)
+				return it.value();
+
+			++it;
+		}
+
+		return -1;
+	}
+};
+
+ShardedClient::ShardedClient(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ShardedClient::~ShardedClient()
+{
+	delete d;
+}
+
+void ShardedClient::setVirtualNodes(int count)
+{
+	assert(d->shards.isEmpty());
+	assert(count >= 4);
+
+	d->virtualNodes = count;
+}
+
+void ShardedClient::setHashTagsEnabled(bool enabled)
+{
+	d->hashTags = enabled;
+}
+
+void ShardedClient::setAuth(const QByteArray &password, const QByteArray &user)
+{
+	d->setup->setAuth(password, user);
+}
+
+void ShardedClient::setDatabase(int index)
+{
+	d->setup->setDatabase(index);
+}
+
+void ShardedClient::setClientName(const QByteArray &name)
+{
+	d->setup->setClientName(name);
+}
+
+void ShardedClient::setProtocolVersion(int version)
+{
+	d->setup->setProtocolVersion(version);
+}
+
+void ShardedClient::setCodec(Codec *codec, int threshold)
+{
+	// shard clients point at the current codec
+	foreach(const Private::Shard &s, d->shards)
+		assert(!s.client);
+
+	d->setup->setCodec(codec, threshold);
+}
+
+void ShardedClient::addShard(const QString &name, const QString &host, int port, int weight)
+{
+	d->addShard(name, host, port, weight);
+}
+
+QStringList ShardedClient::shards() const
+{
+	QStringList out;
+	foreach(const Private::Shard &s, d->shards)
+		out += s.name;
+	return out;
+}
+
+void ShardedClient::setShardDown(const QString &name, bool down)
+{
+	int index = d->indexOf(name);
+	assert(index != -1);
+
+	d->shards[index].down = down;
+}
+
+bool ShardedClient::isShardDown(const QString &name) const
+{
+	int index = d->indexOf(name);
+	assert(index != -1);
+
+	return d->shards[index].down;
+}
+
+QString ShardedClient::shardForKey(const QByteArray &key) const
+{
+	int index = d->shardIndexForKey(key);
+	if(index == -1)
+		return QString();
+
+	return d->shards[index].name;
+}
+
+Client *ShardedClient::clientForKey(const QByteArray &key)
+{
+	int index = d->shardIndexForKey(key);
+	if(index == -1)
+		return 0;
+
+	return clientAt(index);
+}
+
+ShardedRequest *ShardedClient::createRequest()
+{
+	ShardedRequest *req = new ShardedRequest;
+	req->setup(this);
+	return req;
+}
+
+int ShardedClient::shardIndexForKey(const QByteArray &key) const
+{
+	return d->shardIndexForKey(key);
+}
+
+// clients are connected on first use
+Client *ShardedClient::clientAt(int index)
+{
+	Private::Shard &s = d->shards[index];
+	if(!s.client)
+	{
+		s.client = new Client(this);
+		s.client->copySetup(d->setup);
+		s.client->shareCodec(d->setup);
+		s.client->connectToServer(s.host, s.port);
+	}
+
+	return s.client;
+}
+
+}
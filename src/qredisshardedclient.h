@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISSHARDEDCLIENT_H
+#define QREDISSHARDEDCLIENT_H
+
+#include <QObject>
+#include <QStringList>
+
+namespace QRedis {
+
+class Client;
+class Codec;
+class ShardedRequest;
+
+// distributes keys over several independent servers using a ketama-style
+//   consistent hash ring. each shard gets its own Client
+class ShardedClient : public QObject
+{
+	Q_OBJECT
+
+public:
+	ShardedClient(QObject *parent = 0);
+	~ShardedClient();
+
+	// number of ring points per unit of weight. must be set before
+	//   adding shards. default 160
+	void setVirtualNodes(int count);
+
+	// if enabled, only the part of a key between the first '{' and the
+	//   following '}' is hashed, provided it is non-empty. default false
+	void setHashTagsEnabled(bool enabled);
+
+	// applied to the client of each shard. see the Client methods of the
+	//   same names. must be set before the first request
+	void setAuth(const QByteArray &password, const QByteArray &user = QByteArray());
+	void setDatabase(int index);
+	void setClientName(const QByteArray &name);
+	void setProtocolVersion(int version);
+	void setCodec(Codec *codec, int threshold = 1024);
+
+	void addShard(const QString &name, const QString &host, int port, int weight = 1);
+	QStringList shards() const;
+
+	// keys of a down shard move to the next live shard on the ring, and
+	//   no other keys move
+	void setShardDown(const QString &name, bool down);
+	bool isShardDown(const QString &name) const;
+
+	QString shardForKey(const QByteArray &key) const;
+	Client *clientForKey(const QByteArray &key);
+
+	ShardedRequest *createRequest();
+
+private:
+	Q_DISABLE_COPY(ShardedClient)
+
+	friend class ShardedRequest;
+	int shardIndexForKey(const QByteArray &key) const;
+	Client *clientAt(int index);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
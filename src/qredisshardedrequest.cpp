@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisshardedrequest.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredisshardedclient.h"
+#include "qredismultikeyreply.h"
+
+namespace QRedis {
+
+class ShardedRequest::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Mode
+	{
+		Single,
+		MultiGet,
+		MultiSet,
+		MultiDel
+	};
+
+	ShardedRequest *q;
+	ShardedClient *client;
+	bool active;
+	Mode mode;
+	QHash<Request*, QList<int> > parts; // request -> key positions
+	MultiKeyReply merged;
+	Reply result;
+
+	Private(ShardedRequest *_q) :
+		QObject(_q),
+		q(_q),
+		client(0),
+		active(false),
+		mode(Single)
+	{
+	}
+
+	~Private()
+	{
+		cleanup();
+	}
+
+	void cleanup()
+	{
+		QHashIterator<Request*, QList<int> > it(parts);
+		while(it.hasNext())
+		{
+			it.next();
+			delete it.key();
+		}
+
+		parts.clear();
+	}
+
+	void start(const QList<QByteArray> &args)
+	{
+		assert(!active);
+		assert(args.count() >= 2);
+
+		active = true;
+		mode = Single;
+
+		int shard = client->shardIndexForKey(args[1]);
+		if(shard == -1)
+		{
+			QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+			return;
+		}
+
+		startPart(shard, args, QList<int>());
+	}
+
+	void startMulti(Mode _mode, const QByteArray &command, const QList<QByteArray> &keys, const QList<QByteArray> &setValues = QList<QByteArray>())
+	{
+		assert(!active);
+
+		active = true;
+		mode = _mode;
+
+		if(mode == MultiGet)
+			merged.reset(MultiKeyReply::MultiGet, keys.count());
+		else if(mode == MultiSet)
+			merged.reset(MultiKeyReply::MultiSet, keys.count());
+		else // MultiDel
+			merged.reset(MultiKeyReply::MultiDel, keys.count());
+
+		QHash<int, QList<int> > positionsByShard;
+		for(int n = 0; n < keys.count(); ++n)
+		{
+			int shard = client->shardIndexForKey(keys[n]);
+			if(shard == -1)
+			{
+				QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+				return;
+			}
+
+			positionsByShard[shard] += n;
+		}
+
+		QHashIterator<int, QList<int> > it(positionsByShard);
+		while(it.hasNext())
+		{
+			it.next();
+			const QList<int> &positions = it.value();
+
+			QList<QByteArray> args;
+			args += command;
+			foreach(int pos, positions)
+			{
+				args += keys[pos];
+				if(mode == MultiSet)
+					args += setValues[pos];
+			}
+
+			startPart(it.key(), args, positions);
+		}
+
+		if(parts.isEmpty())
+			QMetaObject::invokeMethod(this, "handleFinished", Qt::QueuedConnection);
+	}
+
+private:
+	void startPart(int shard, const QList<QByteArray> &args, const QList<int> &positions)
+	{
+		Request *req = client->clientAt(shard)->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(req_error()));
+		parts.insert(req, positions);
+		req->start(args);
+	}
+
+private slots:
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+		QList<int> positions = parts.take(req);
+		delete req;
+
+		if(mode == Single)
+		{
+			result = reply;
+		}
+		else if(!merged.add(reply, positions))
+		{
+			handleError();
+			return;
+		}
+
+		if(parts.isEmpty())
+			handleFinished();
+	}
+
+	void req_error()
+	{
+		Request *req = (Request *)sender();
+		parts.remove(req);
+		delete req;
+
+		handleError();
+	}
+
+	void handleFinished()
+	{
+		active = false;
+
+		Reply r;
+		if(mode == Single)
+			r = result;
+		else
+			r = merged.result();
+
+		merged.reset(MultiKeyReply::MultiGet, 0);
+		result = Reply();
+
+		emit q->readyRead(r);
+	}
+
+	void handleError()
+	{
+		cleanup();
+		merged.reset(MultiKeyReply::MultiGet, 0);
+
+		active = false;
+		emit q->error();
+	}
+};
+
+ShardedRequest::ShardedRequest(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ShardedRequest::~ShardedRequest()
+{
+	delete d;
+}
+
+void ShardedRequest::set(const QByteArray &key, const QByteArray &value)
+{
+	d->start(QList<QByteArray>() << "SET" << key << value);
+}
+
+void ShardedRequest::get(const QByteArray &key)
+{
+	d->start(QList<QByteArray>() << "GET" << key);
+}
+
+void ShardedRequest::del(const QByteArray &key)
+{
+	d->start(QList<QByteArray>() << "DEL" << key);
+}
+
+void ShardedRequest::mget(const QList<QByteArray> &keys)
+{
+	d->startMulti(Private::MultiGet, "MGET", keys);
+}
+
+void ShardedRequest::mset(const QList<QPair<QByteArray, QByteArray> > &pairs)
+{
+	QList<QByteArray> keys;
+	QList<QByteArray> values;
+	for(int n = 0; n < pairs.count(); ++n)
+	{
+		keys += pairs[n].first;
+		values += pairs[n].second;
+	}
+
+	d->startMulti(Private::MultiSet, "MSET", keys, values);
+}
+
+void ShardedRequest::del(const QList<QByteArray> &keys)
+{
+	d->startMulti(Private::MultiDel, "DEL", keys);
+}
+
+void ShardedRequest::start(const QList<QByteArray> &args)
+{
+	d->start(args);
+}
+
+void ShardedRequest::setup(ShardedClient *client)
+{
+	d->client = client;
+}
+
+}
+
+#include "qredisshardedrequest.moc"
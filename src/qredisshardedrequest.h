@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISSHARDEDREQUEST_H
+#define QREDISSHARDEDREQUEST_H
+
+#include <QObject>
+#include <QPair>
+
+namespace QRedis {
+
+class ShardedClient;
+class Reply;
+
+class ShardedRequest : public QObject
+{
+	Q_OBJECT
+
+public:
+	~ShardedRequest();
+
+	void set(const QByteArray &key, const QByteArray &value);
+	void get(const QByteArray &key);
+	void del(const QByteArray &key);
+
+	// multi-key commands are split per shard, sent in parallel, and the
+	//   replies merged. mget() replies with values in the order of keys,
+	//   del() with the total count, and mset() with OK. if any shard
+	//   replies with an error, the first such reply is the reply
+	void mget(const QList<QByteArray> &keys);
+	void mset(const QList<QPair<QByteArray, QByteArray> > &pairs);
+	void del(const QList<QByteArray> &keys);
+
+	// single-key commands only. args[1] is taken as the key
+	void start(const QList<QByteArray> &args);
+
+signals:
+	void readyRead(const QRedis::Reply &reply);
+	void error();
+
+private:
+	Q_DISABLE_COPY(ShardedRequest)
+
+	friend class ShardedClient;
+	ShardedRequest(QObject *parent = 0);
+	void setup(ShardedClient *client);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredisstreamconsumer.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QPointer>
+#include <QTimer>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+
+namespace QRedis {
+
+// parses a list of [id, [field, value, ...]] items
+static bool parseEntries(const QByteArray &stream, const QVariantList &items, QList<StreamEntry> *out)
+{
+	foreach(const QVariant &i, items)
+	{
+		if(i.type() != QVariant::List)
+			return false;
+
+		QVariantList item = i.toList();
+		if(item.count() < 2)
+			return false;
+
+		StreamEntry e;
+		e.stream = stream;
+		e.id = item[0].toByteArray();
+
+		QVariantList fields = item[1].toList();
+		for(int n = 0; n + 1 < fields.count(); n += 2)
+			e.fields += qMakePair(fields[n].toByteArray(), fields[n + 1].toByteArray());
+
+		*out += e;
+	}
+
+	return true;
+}
+
+class StreamConsumer::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	StreamConsumer *q;
+	Client *client;
+	QByteArray group;
+	QByteArray consumer;
+	QList<QByteArray> streams;
+	int count;
+	int blockTimeout;
+	int prefetch;
+	int claimMinIdle;
+	bool active;
+	bool backlog;
+	QHash<QByteArray, QByteArray> backlogIds;
+	int outstanding;
+	Request *readReq;
+	QTimer *readRetryTimer;
+	Request *claimReq;
+	QList<QByteArray> claimStreams;
+	QByteArray claimCursor;
+	QTimer *claimTimer;
+	QHash<QByteArray, QList<QByteArray> > pendingAcks;
+	QHash<Request*, QPair<QByteArray, QList<QByteArray> > > ackReqs;
+	QTimer *ackTimer;
+
+	Private(StreamConsumer *_q, Client *_client) :
+		QObject(_q),
+		q(_q),
+		client(_client),
+		count(100),
+		blockTimeout(5000),
+		prefetch(1000),
+		claimMinIdle(0),
+		active(false),
+		backlog(false),
+		outstanding(0),
+		readReq(0),
+		claimReq(0)
+	{
+		readRetryTimer = new QTimer(this);
+		connect(readRetryTimer, SIGNAL(timeout()), SLOT(readRetry_timeout()));
+		readRetryTimer->setSingleShot(true);
+		readRetryTimer->setInterval(1000);
+
+		claimTimer = new QTimer(this);
+		connect(claimTimer, SIGNAL(timeout()), SLOT(claim_timeout()));
+
+		ackTimer = new QTimer(this);
+		connect(ackTimer, SIGNAL(timeout()), SLOT(ack_timeout()));
+		ackTimer->setSingleShot(true);
+		ackTimer->setInterval(100);
+	}
+
+	~Private()
+	{
+		cleanup();
+
+		QHashIterator<Request*, QPair<QByteArray, QList<QByteArray> > > it(ackReqs);
+		while(it.hasNext())
+		{
+			it.next();
+			delete it.key();
+		}
+	}
+
+	void cleanup()
+	{
+		delete readReq;
+		readReq = 0;
+
+		delete claimReq;
+		claimReq = 0;
+
+		readRetryTimer->stop();
+		claimTimer->stop();
+	}
+
+	void start()
+	{
+		assert(!active);
+		assert(!group.isEmpty());
+		assert(!streams.isEmpty());
+
+		active = true;
+		outstanding = 0;
+
+		// re-read our own pending entries before asking for new ones
+		backlog = true;
+		backlogIds.clear();
+		foreach(const QByteArray &stream, streams)
+			backlogIds[stream] = "0";
+
+		if(claimMinIdle > 0)
+		{
+			startClaim();
+			claimTimer->start(claimMinIdle);
+		}
+
+		readNext();
+	}
+
+	void stop()
+	{
+		if(!active)
+			return;
+
+		active = false;
+		cleanup();
+		flushAcks();
+	}
+
+	void ack(const QByteArray &stream, const QByteArray &id)
+	{
+		pendingAcks[stream] += id;
+
+		if(outstanding > 0)
+			--outstanding;
+
+		if(!ackTimer->isActive())
+			ackTimer->start();
+
+		// window space may have opened up
+		readNext();
+		claimNext();
+	}
+
+private:
+	void readNext()
+	{
+		if(!active || readReq || readRetryTimer->isActive())
+			return;
+
+		int space = prefetch - outstanding;
+		if(space <= 0)
+			return;
+
+		QList<QByteArray> args;
+		args << "XREADGROUP" << "GROUP" << group << consumer;
+		args << "COUNT" << QByteArray::number(qMin(count, space));
+		if(!backlog)
+			args << "BLOCK" << QByteArray::number(blockTimeout);
+		args << "STREAMS";
+		args += streams;
+		foreach(const QByteArray &stream, streams)
+			args += (backlog ? backlogIds.value(stream) : QByteArray(">"));
+
+		// blocking reads are run on a leased connection by the client
+		readReq = client->createRequest();
+		connect(readReq, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(read_readyRead(const QRedis::Reply &)));
+		connect(readReq, SIGNAL(error()), SLOT(read_error()));
+		readReq->start(args);
+	}
+
+	void startClaim()
+	{
+		if(claimReq || !claimStreams.isEmpty())
+			return;
+
+		claimStreams = streams;
+		claimCursor = "0-0";
+		claimNext();
+	}
+
+	void claimNext()
+	{
+		if(!active || claimReq || claimStreams.isEmpty())
+			return;
+
+		int space = prefetch - outstanding;
+		if(space <= 0)
+			return;
+
+		QList<QByteArray> args;
+		args << "XAUTOCLAIM" << claimStreams.first() << group << consumer;
+		args << QByteArray::number(claimMinIdle) << claimCursor;
+		args << "COUNT" << QByteArray::number(qMin(count, space));
+
+		claimReq = client->createRequest();
+		connect(claimReq, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(claim_readyRead(const QRedis::Reply &)));
+		connect(claimReq, SIGNAL(error()), SLOT(claim_error()));
+		claimReq->start(args);
+	}
+
+	void flushAcks()
+	{
+		ackTimer->stop();
+
+		// one XACK per stream. the requests are all issued at once, so they
+		//   go out pipelined
+		QHashIterator<QByteArray, QList<QByteArray> > it(pendingAcks);
+		while(it.hasNext())
+		{
+			it.next();
+
+			QList<QByteArray> args;
+			args << "XACK" << it.key() << group;
+			args += it.value();
+
+			Request *req = client->createRequest();
+			connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(ack_readyRead(const QRedis::Reply &)));
+			connect(req, SIGNAL(error()), SLOT(ack_error()));
+			ackReqs.insert(req, qMakePair(it.key(), it.value()));
+			req->start(args);
+		}
+
+		pendingAcks.clear();
+	}
+
+	// returns false if the consumer was deleted by the handler
+	bool deliver(const QList<StreamEntry> &entries)
+	{
+		if(entries.isEmpty())
+			return true;
+
+		outstanding += entries.count();
+
+		QPointer<QObject> self = this;
+		emit q->entriesReady(entries);
+		return !self.isNull();
+	}
+
+	void fail()
+	{
+		active = false;
+		cleanup();
+		flushAcks();
+
+		emit q->error();
+	}
+
+private slots:
+	void read_readyRead(const QRedis::Reply &reply)
+	{
+		delete readReq;
+		readReq = 0;
+
+		QList<StreamEntry> entries;
+
+		// null means the block timed out
+		if(!reply.value.isNull())
+		{
+			if(reply.value.type() != QVariant::List)
+			{
+				// error reply, such as NOGROUP
+				fail();
+				return;
+			}
+
+			foreach(const QVariant &s, reply.value.toList())
+			{
+				QVariantList streamItem = s.toList();
+				if(streamItem.count() < 2 || !parseEntries(streamItem[0].toByteArray(), streamItem[1].toList(), &entries))
+				{
+					fail();
+					return;
+				}
+			}
+		}
+
+		if(backlog)
+		{
+			if(entries.isEmpty())
+				backlog = false;
+
+			foreach(const StreamEntry &e, entries)
+				backlogIds[e.stream] = e.id;
+		}
+
+		if(!deliver(entries))
+			return;
+
+		readNext();
+	}
+
+	void read_error()
+	{
+		delete readReq;
+		readReq = 0;
+
+		// the connection will reconnect on its own
+		readRetryTimer->start();
+	}
+
+	void readRetry_timeout()
+	{
+		readNext();
+	}
+
+	void claim_readyRead(const QRedis::Reply &reply)
+	{
+		delete claimReq;
+		claimReq = 0;
+
+		QVariantList l = reply.value.toList();
+		QList<StreamEntry> entries;
+		if(reply.value.type() != QVariant::List || l.count() < 2 || !parseEntries(claimStreams.first(), l[1].toList(), &entries))
+		{
+			// XAUTOCLAIM unsupported or stream missing. give up this pass
+			claimStreams.clear();
+			return;
+		}
+
+		// a cursor of 0-0 means this stream is done
+		claimCursor = l[0].toByteArray();
+		if(claimCursor == "0-0")
+			claimStreams.removeFirst();
+
+		if(!deliver(entries))
+			return;
+
+		claimNext();
+	}
+
+	void claim_error()
+	{
+		delete claimReq;
+		claimReq = 0;
+
+		claimStreams.clear();
+	}
+
+	void claim_timeout()
+	{
+		startClaim();
+	}
+
+	void ack_timeout()
+	{
+		flushAcks();
+	}
+
+	void ack_readyRead(const QRedis::Reply &reply)
+	{
+		Q_UNUSED(reply);
+
+		Request *req = (Request *)sender();
+		ackReqs.remove(req);
+		delete req;
+	}
+
+	void ack_error()
+	{
+		Request *req = (Request *)sender();
+		QPair<QByteArray, QList<QByteArray> > acks = ackReqs.take(req);
+		delete req;
+
+		// the entries stay pending on the server, so try again next flush
+		pendingAcks[acks.first] += acks.second;
+		if(!ackTimer->isActive())
+			ackTimer->start();
+	}
+};
+
+StreamConsumer::StreamConsumer(Client *client, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, client);
+}
+
+StreamConsumer::~StreamConsumer()
+{
+	delete d;
+}
+
+void StreamConsumer::setGroup(const QByteArray &group, const QByteArray &consumer)
+{
+	d->group = group;
+	d->consumer = consumer;
+}
+
+void StreamConsumer::setStreams(const QList<QByteArray> &streams)
+{
+	d->streams = streams;
+}
+
+void StreamConsumer::setCount(int count)
+{
+	d->count = count;
+}
+
+void StreamConsumer::setBlockTimeout(int msecs)
+{
+	d->blockTimeout = msecs;
+}
+
+void StreamConsumer::setPrefetch(int count)
+{
+	d->prefetch = count;
+}
+
+void StreamConsumer::setAckInterval(int msecs)
+{
+	d->ackTimer->setInterval(msecs);
+}
+
+void StreamConsumer::setClaimMinIdleTime(int msecs)
+{
+	d->claimMinIdle = msecs;
+}
+
+void StreamConsumer::start()
+{
+	d->start();
+}
+
+void StreamConsumer::stop()
+{
+	d->stop();
+}
+
+void StreamConsumer::ack(const StreamEntry &entry)
+{
+	d->ack(entry.stream, entry.id);
+}
+
+void StreamConsumer::ack(const QByteArray &stream, const QByteArray &id)
+{
+	d->ack(stream, id);
+}
+
+}
+
+#include "qredisstreamconsumer.moc"
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISSTREAMCONSUMER_H
+#define QREDISSTREAMCONSUMER_H
+
+#include <QObject>
+#include "qredisstreamentry.h"
+
+namespace QRedis {
+
+class Client;
+
+// reads streams as a member of a consumer group. blocking reads are run
+//   on a connection leased from the client, so they don't hold up other
+//   requests
+class StreamConsumer : public QObject
+{
+	Q_OBJECT
+
+public:
+	StreamConsumer(Client *client, QObject *parent = 0);
+	~StreamConsumer();
+
+	void setGroup(const QByteArray &group, const QByteArray &consumer);
+	void setStreams(const QList<QByteArray> &streams);
+
+	// maximum entries per read. default 100
+	void setCount(int count);
+
+	// how long a read may block on the server. default 5000
+	void setBlockTimeout(int msecs);
+
+	// maximum entries delivered but not yet acknowledged. reading pauses
+	//   while this many are outstanding. default 1000
+	void setPrefetch(int count);
+
+	// acknowledgements are collected and sent as one XACK per stream at
+	//   this interval. default 100
+	void setAckInterval(int msecs);
+
+	// if non-zero, entries of other consumers that have been pending for
+	//   at least this long are claimed, at start and then periodically.
+	//   requires XAUTOCLAIM (Redis 6.2). default 0
+	void setClaimMinIdleTime(int msecs);
+
+	// entries still pending for this consumer (e.g. after a crash) are
+	//   delivered first
+	void start();
+
+	// flushes pending acknowledgements
+	void stop();
+
+	void ack(const StreamEntry &entry);
+	void ack(const QByteArray &stream, const QByteArray &id);
+
+signals:
+	void entriesReady(const QList<QRedis::StreamEntry> &entries);
+	void error();
+
+private:
+	Q_DISABLE_COPY(StreamConsumer)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
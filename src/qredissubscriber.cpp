@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredissubscriber.h"
+
+#include <assert.h>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredispatternmatcher.h"
+
+namespace QRedis {
+
+static QByteArray subscriptionKey(const QByteArray &pattern)
+{
+	if(PatternMatcher::isPattern(pattern))
+		return "p:" + pattern;
+	else
+		return "c:" + pattern;
+}
+
+class Subscriber::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Listener
+	{
+	public:
+		QByteArray pattern;
+		QObject *receiver;
+		QByteArray method;
+	};
+
+	Subscriber *q;
+	Client *client;
+	PatternMatcher matcher;
+	QHash<int, Listener> listeners;
+	QHash<QObject*, QList<int> > receivers;
+	int nextId;
+	QHash<QByteArray, Request*> subs; // "c:channel" or "p:pattern" -> request
+	QHash<Request*, QByteArray> subKeys;
+	QSet<Request*> unconfirmed;
+	bool syncPending;
+
+	Private(Subscriber *_q, Client *source) :
+		QObject(_q),
+		q(_q),
+		nextId(0),
+		syncPending(false)
+	{
+		client = new Client(this);
+		client->copySetup(source);
+		connect(client, SIGNAL(setupFailed(const QByteArray &)), q, SIGNAL(setupFailed(const QByteArray &)));
+		client->connectToServer(source->host(), source->port());
+	}
+
+	~Private()
+	{
+		QHashIterator<Request*, QByteArray> it(subKeys);
+		while(it.hasNext())
+		{
+			it.next();
+			delete it.key();
+		}
+	}
+
+	int addListener(const QByteArray &pattern, QObject *receiver, const char *method)
+	{
+		assert(receiver);
+		assert(method);
+
+		int id = nextId++;
+
+		Listener l;
+		l.pattern = pattern;
+		l.receiver = receiver;
+		l.method = method;
+		listeners.insert(id, l);
+
+		matcher.insert(id, pattern);
+
+		if(!receivers.contains(receiver))
+			connect(receiver, SIGNAL(destroyed(QObject *)), SLOT(receiver_destroyed(QObject *)));
+		receivers[receiver] += id;
+
+		scheduleSync();
+
+		return id;
+	}
+
+	void removeListener(int id)
+	{
+		if(!listeners.contains(id))
+			return;
+
+		Listener l = listeners.take(id);
+		matcher.remove(id);
+
+		QHash<QObject*, QList<int> >::iterator it = receivers.find(l.receiver);
+		assert(it != receivers.end());
+		it.value().removeAll(id);
+		if(it.value().isEmpty())
+		{
+			receivers.erase(it);
+			disconnect(l.receiver, SIGNAL(destroyed(QObject *)), this, SLOT(receiver_destroyed(QObject *)));
+		}
+
+		scheduleSync();
+	}
+
+private:
+	void scheduleSync()
+	{
+		if(syncPending)
+			return;
+
+		// coalesce listener changes made in the same event loop pass
+		syncPending = true;
+		QMetaObject::invokeMethod(this, "sync", Qt::QueuedConnection);
+	}
+
+	// one server subscription per distinct listener pattern. narrowing
+	//   them to shared prefixes would make the server send messages no
+	//   listener wants (a pattern with no literal prefix would need "*")
+	QSet<QByteArray> desiredSubscriptions() const
+	{
+		QSet<QByteArray> out;
+
+		QHashIterator<int, Listener> it(listeners);
+		while(it.hasNext())
+		{
+			it.next();
+			out += subscriptionKey(it.value().pattern);
+		}
+
+		return out;
+	}
+
+	void subscribe(const QByteArray &key)
+	{
+		Request *req = client->createRequest();
+		connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+		connect(req, SIGNAL(error()), SLOT(req_error()));
+		subs.insert(key, req);
+		subKeys.insert(req, key);
+		unconfirmed += req;
+
+		if(key.startsWith("p:"))
+			req->start("PSUBSCRIBE", key.mid(2));
+		else
+			req->start("SUBSCRIBE", key.mid(2));
+	}
+
+	void dropRequest(Request *req)
+	{
+		subs.remove(subKeys.take(req));
+		unconfirmed.remove(req);
+		delete req;
+	}
+
+	// a message arrives once for every subscription it matches, but is
+	//   dispatched from only one of them, to every matching listener.
+	//   the one chosen is the smallest confirmed key among the matches
+	void dispatch(Request *req, const QByteArray &channel, const QByteArray &message)
+	{
+		QList<int> ids = matcher.match(channel);
+
+		QByteArray first;
+		foreach(int id, ids)
+		{
+			QByteArray key = subscriptionKey(listeners.value(id).pattern);
+			Request *sub = subs.value(key);
+			if(sub && !unconfirmed.contains(sub) && (first.isNull() || key < first))
+				first = key;
+		}
+
+		if(subKeys.value(req) != first)
+			return;
+
+		QPointer<QObject> self = this;
+		foreach(int id, ids)
+		{
+			// listeners may be removed by earlier handlers
+			QHash<int, Listener>::const_iterator it = listeners.find(id);
+			if(it == listeners.constEnd())
+				continue;
+
+			Listener l = it.value();
+			QMetaObject::invokeMethod(l.receiver, l.method.constData(), Qt::DirectConnection, Q_ARG(QByteArray, channel), Q_ARG(QByteArray, message));
+			if(!self)
+				return;
+		}
+	}
+
+private slots:
+	void sync()
+	{
+		syncPending = false;
+
+		QSet<QByteArray> desired = desiredSubscriptions();
+
+		// deleting a subscription request unsubscribes it
+		foreach(const QByteArray &key, subs.keys())
+		{
+			if(!desired.contains(key))
+				dropRequest(subs.value(key));
+		}
+
+		foreach(const QByteArray &key, desired)
+		{
+			if(!subs.contains(key))
+				subscribe(key);
+		}
+
+		if(unconfirmed.isEmpty())
+			emit q->subscribed();
+	}
+
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		Request *req = (Request *)sender();
+
+		QVariantList l = reply.value.toList();
+		if(reply.value.type() != QVariant::List || l.isEmpty())
+			return;
+
+		QByteArray type = l[0].toByteArray();
+		if(type == "message" && l.count() >= 3)
+		{
+			dispatch(req, l[1].toByteArray(), l[2].toByteArray());
+		}
+		else if(type == "pmessage" && l.count() >= 4)
+		{
+			dispatch(req, l[2].toByteArray(), l[3].toByteArray());
+		}
+		else if(type == "subscribe" || type == "psubscribe")
+		{
+			if(unconfirmed.remove(req) && unconfirmed.isEmpty())
+				emit q->subscribed();
+		}
+	}
+
+	void req_error()
+	{
+		dropRequest((Request *)sender());
+
+		// resubscribe. the request waits for the client to reconnect
+		scheduleSync();
+	}
+
+	void receiver_destroyed(QObject *obj)
+	{
+		QList<int> ids = receivers.take(obj);
+		foreach(int id, ids)
+		{
+			listeners.remove(id);
+			matcher.remove(id);
+		}
+
+		scheduleSync();
+	}
+};
+
+Subscriber::Subscriber(Client *client, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, client);
+}
+
+Subscriber::~Subscriber()
+{
+	delete d;
+}
+
+int Subscriber::addListener(const QByteArray &pattern, QObject *receiver, const char *method)
+{
+	return d->addListener(pattern, receiver, method);
+}
+
+void Subscriber::removeListener(int id)
+{
+	d->removeListener(id);
+}
+
+int Subscriber::listenerCount() const
+{
+	return d->listeners.count();
+}
+
+}
+
+#include "qredissubscriber.moc"
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISSUBSCRIBER_H
+#define QREDISSUBSCRIBER_H
+
+#include <QObject>
+
+namespace QRedis {
+
+class Client;
+
+// dispatches published messages to many local listeners. the server is
+//   subscribed to each distinct listener pattern, and listener patterns
+//   are kept in a PatternMatcher, so a message matching several patterns
+//   is dispatched once, to all matching listeners, in time proportional
+//   to the channel length. subscribing puts a connection into
+//   pubsub mode, so the subscriber opens its own connection to the server
+//   of the given client, using the same credentials, database, name and
+//   protocol
+class Subscriber : public QObject
+{
+	Q_OBJECT
+
+public:
+	Subscriber(Client *client, QObject *parent = 0);
+	~Subscriber();
+
+	// the method is invoked by name with the signature
+	//   (const QByteArray &channel, const QByteArray &message). listeners
+	//   are removed automatically when the receiver is destroyed. returns a
+	//   listener id
+	int addListener(const QByteArray &pattern, QObject *receiver, const char *method);
+	void removeListener(int id);
+
+	int listenerCount() const;
+
+signals:
+	// the server subscriptions changed and all of them are active
+	void subscribed();
+
+	// the subscriber's connection was refused by the server. see
+	//   Client::setupFailed()
+	void setupFailed(const QByteArray &message);
+
+private:
+	Q_DISABLE_COPY(Subscriber)
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
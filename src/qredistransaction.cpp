@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "qredistransaction.h"
+
+#include <assert.h>
+#include <hiredis/async.h>
+#include <QPair>
+#include <QVariant>
+#include "qredisclient.h"
+#include "qredisconnection.h"
+#include "qredisrequest.h"
+#include "qredisreplybuilder.h"
+
+namespace QRedis {
+
+class Transaction::Private : public QObject, public LeaseWaiter
+{
+	Q_OBJECT
+
+public:
+	enum Stage
+	{
+		Watch,
+		Multi,
+		Queued,
+		Exec
+	};
+
+	// shared by every command of the transaction. replies arrive in the
+	//   order the commands were written, so the stage is implied
+	class CommandItem
+	{
+	public:
+		Private *tp;
+		int refs;
+	};
+
+	Transaction *q;
+	Client *client;
+	Connection *connection;
+	bool leased;
+	bool waitingLease;
+	bool active;
+	bool failed;
+	CommandItem *commandItem;
+	bool watching;
+	bool watchLost;
+	QList<QList<QByteArray> > commands;
+	QList<QPair<Stage, QList<QByteArray> > > unsent; // while waiting for a lease
+	QList<QPair<int, Stage> > sent; // queue ids of commands not yet replied to
+	QList<Reply> replies;
+
+	Private(Transaction *_q) :
+		QObject(_q),
+		q(_q),
+		client(0),
+		connection(0),
+		leased(false),
+		waitingLease(false),
+		active(false),
+		failed(false),
+		commandItem(0),
+		watching(false),
+		watchLost(false)
+	{
+	}
+
+	~Private()
+	{
+		cancel();
+	}
+
+	void cancel()
+	{
+		if(waitingLease)
+		{
+			client->cancelLease(this);
+			waitingLease = false;
+		}
+
+		unsent.clear();
+
+		bool execSent = false;
+
+		if(commandItem)
+		{
+			// a block is handed to hiredis in one go, so either all of an
+			//   exec block is taken back here or none of it
+			for(int n = 0; n < sent.count(); ++n)
+			{
+				if(connection->cancel(sent[n].first))
+				{
+					--(commandItem->refs);
+					sent.removeAt(n);
+					--n;
+				}
+			}
+
+			// the replies to the rest won't reach us
+			for(int n = 0; n < sent.count(); ++n)
+			{
+				connection->recordReply(sent[n].first, 0);
+				if(sent[n].second == Exec)
+					execSent = true;
+			}
+
+			if(commandItem->refs == 0)
+				delete commandItem;
+			else
+				commandItem->tp = 0;
+
+			commandItem = 0;
+		}
+
+		// don't hand the connection on while it is watching keys, or the
+		//   next transaction on it could be aborted
+		if(watching && !execSent && connection)
+			connection->enqueue(QList<QByteArray>() << "UNWATCH", 0, 0);
+
+		releaseLease();
+
+		sent.clear();
+		commands.clear();
+		replies.clear();
+		watching = false;
+		watchLost = false;
+		active = false;
+	}
+
+	void watch(const QList<QByteArray> &keys)
+	{
+		assert(!active);
+		assert(!keys.isEmpty());
+
+		QList<QByteArray> args;
+		args += "WATCH";
+		args += keys;
+		send(Watch, args);
+
+		watching = true;
+	}
+
+	void exec()
+	{
+		assert(!active);
+		assert(!commands.isEmpty());
+
+		active = true;
+		failed = false;
+		replies.clear();
+
+		// the watches went away with the connection, and the keys could
+		//   have changed unnoticed since, so EXEC can't be sent safely
+		if(watching && (watchLost || (connection && !connection->context())))
+		{
+			failed = true;
+			watching = false;
+			watchLost = false;
+			releaseLease();
+			QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+			return;
+		}
+
+		// nothing else runs between these, so they stay contiguous in the
+		//   connection's queue
+		send(Multi, QList<QByteArray>() << "MULTI");
+		foreach(const QList<QByteArray> &args, commands)
+			send(Queued, args);
+		send(Exec, QList<QByteArray>() << "EXEC");
+	}
+
+	virtual void leaseReady(Connection *conn)
+	{
+		waitingLease = false;
+		takeLease(conn);
+
+		QList<QPair<Stage, QList<QByteArray> > > cmds = unsent;
+		unsent.clear();
+
+		for(int n = 0; n < cmds.count(); ++n)
+			send(cmds[n].first, cmds[n].second);
+	}
+
+private:
+	void send(Stage stage, const QList<QByteArray> &args)
+	{
+		if(!connection && !waitingLease)
+		{
+			// other traffic on a shared connection could clear the
+			//   watches, so a watching transaction gets a connection of
+			//   its own until EXEC
+			if(stage == Watch)
+			{
+				Connection *conn = client->leaseConnection(this);
+				if(conn)
+					takeLease(conn);
+				else
+					waitingLease = true;
+			}
+			else
+			{
+				connection = client->connectionForPriority(Request::NormalPriority);
+			}
+		}
+
+		if(waitingLease)
+		{
+			// sent by leaseReady()
+			unsent += qMakePair(stage, args);
+			return;
+		}
+
+		if(!commandItem)
+		{
+			commandItem = new CommandItem;
+			commandItem->tp = this;
+			commandItem->refs = 0;
+		}
+
+		++(commandItem->refs);
+		sent += qMakePair(connection->enqueue(args, cb_command, commandItem), stage);
+
+		if(stage == Queued)
+			client->sampleCommand(args);
+	}
+
+	void takeLease(Connection *conn)
+	{
+		connection = conn;
+		leased = true;
+		connect(connection, SIGNAL(disconnected()), SLOT(connection_disconnected()));
+	}
+
+	void releaseLease()
+	{
+		if(leased)
+		{
+			disconnect(connection, SIGNAL(disconnected()), this, SLOT(connection_disconnected()));
+			leased = false;
+			client->releaseConnection(connection, true);
+		}
+
+		connection = 0;
+	}
+
+	static void cb_command(redisAsyncContext *c, void *reply, void *privdata)
+	{
+		Q_UNUSED(c);
+
+		CommandItem *ci = (CommandItem *)privdata;
+		Private *tp = ci->tp;
+
+		if(--(ci->refs) == 0)
+		{
+			if(tp)
+				tp->commandItem = 0;
+
+			delete ci;
+		}
+
+		if(tp)
+			tp->cb_command(reply);
+	}
+
+	void cb_command(void *reply)
+	{
+		QPair<int, Stage> item = sent.takeFirst();
+		Stage stage = item.second;
+
+		QVariant value;
+		if(reply)
+			value = replyBuilderValue(reply);
+
+		connection->recordReply(item.first, reply);
+
+		// EXEC clears the watches, whatever its outcome, so the connection
+		//   is done with
+		if(stage == Exec)
+		{
+			watching = false;
+			releaseLease();
+		}
+
+		if(!reply)
+		{
+			if(stage == Watch)
+				watchLost = true;
+
+			if(active && !failed)
+			{
+				failed = true;
+				QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+			}
+			return;
+		}
+
+		if(stage == Watch)
+		{
+			// an error here surfaces through EXEC
+			QMetaObject::invokeMethod(this, "handleWatched", Qt::QueuedConnection);
+			return;
+		}
+		else if(stage == Multi || stage == Queued)
+		{
+			// a command rejected while queueing makes EXEC fail with
+			//   EXECABORT, which is reported then
+			return;
+		}
+
+		// Exec
+		if(failed)
+			return;
+
+		if(value.isNull())
+		{
+			QMetaObject::invokeMethod(this, "handleAborted", Qt::QueuedConnection);
+			return;
+		}
+
+		QVariantList l = value.toList();
+		if(value.type() != QVariant::List || l.count() != commands.count())
+		{
+			failed = true;
+			QMetaObject::invokeMethod(this, "handleError", Qt::QueuedConnection);
+			return;
+		}
+
+		for(int n = 0; n < l.count(); ++n)
+		{
+			const void *element = replyBuilderElement(reply, n);
+			client->sampleReply(commands[n], element);
+
+			// a command can fail inside EXEC without failing the rest
+			Reply r;
+			r.value = l[n];
+			r.error = replyBuilderIsError(element);
+			if(!r.error)
+				client->decodeReply(commands[n], &r.value);
+			replies += r;
+		}
+
+		QMetaObject::invokeMethod(this, "handleReply", Qt::QueuedConnection);
+	}
+
+private slots:
+	void connection_disconnected()
+	{
+		if(watching)
+			watchLost = true;
+	}
+
+	void handleWatched()
+	{
+		if(!watching)
+			return;
+
+		emit q->watched();
+	}
+
+	void handleReply()
+	{
+		if(!active)
+			return;
+
+		active = false;
+		commands.clear();
+
+		// emit a copy from the stack, so the transaction is deletable
+		QList<Reply> r = replies;
+		replies.clear();
+
+		emit q->readyRead(r);
+	}
+
+	void handleAborted()
+	{
+		if(!active)
+			return;
+
+		active = false;
+		commands.clear();
+		emit q->aborted();
+	}
+
+	void handleError()
+	{
+		if(!active)
+			return;
+
+		active = false;
+		commands.clear();
+		emit q->error();
+	}
+};
+
+Transaction::Transaction(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+Transaction::~Transaction()
+{
+	delete d;
+}
+
+void Transaction::watch(const QList<QByteArray> &keys)
+{
+	d->watch(keys);
+}
+
+void Transaction::add(const QList<QByteArray> &args)
+{
+	assert(!d->active);
+	assert(!args.isEmpty());
+
+	QList<QByteArray> encoded = args;
+	d->client->encodeArgs(&encoded);
+	d->commands += encoded;
+}
+
+int Transaction::count() const
+{
+	return d->commands.count();
+}
+
+void Transaction::exec()
+{
+	d->exec();
+}
+
+void Transaction::cancel()
+{
+	d->cancel();
+}
+
+void Transaction::setup(Client *client)
+{
+	d->client = client;
+}
+
+}
+
+#include "qredistransaction.moc"
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 Justin Karneges
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef QREDISTRANSACTION_H
+#define QREDISTRANSACTION_H
+
+#include <QObject>
+#include "qredisreply.h"
+
+namespace QRedis {
+
+class Client;
+
+// MULTI/EXEC. commands are collected locally and written to the connection
+//   as one contiguous block, so the whole transaction costs a single round
+//   trip and other requests on the client can't interleave with it
+class Transaction : public QObject
+{
+	Q_OBJECT
+
+public:
+	~Transaction();
+
+	// WATCH is sent as soon as this is called, on a connection leased for
+	//   the transaction until EXEC (see Client::setMaxBlockingConnections()),
+	//   so other requests can't clear it. that connection is separate from
+	//   the client's, so reads protected by the watch should be made after
+	//   watched() is emitted. may be called more than once
+	void watch(const QList<QByteArray> &keys);
+
+	void add(const QList<QByteArray> &args);
+
+	int count() const;
+
+	// emits readyRead() with one reply per command, in the order added,
+	//   or aborted() if a watched key was modified. if the connection
+	//   holding the watches dropped since watch(), nothing is sent and
+	//   error() is emitted
+	void exec();
+
+	// drops the transaction. commands not yet written are not sent.
+	//   deleting the transaction does the same
+	void cancel();
+
+signals:
+	// the keys of a watch() call are being watched
+	void watched();
+
+	void readyRead(const QList<QRedis::Reply> &replies);
+	void aborted();
+	void error();
+
+private:
+	Q_DISABLE_COPY(Transaction)
+
+	friend class Client;
+	Transaction(QObject *parent = 0);
+	void setup(Client *client);
+
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -120,9 +120,13 @@ class RedisQtAdapter : public QObject {
             m_ctx = 0;
         }
 
+    signals:
+        // emitted after each attempt to write out the output buffer
+        void written();
+
     private slots:
         void read() { redisAsyncHandleRead(m_ctx); }
-        void write() { redisAsyncHandleWrite(m_ctx); }
+        void write() { redisAsyncHandleWrite(m_ctx); emit written(); }
 
     private:
         redisAsyncContext * m_ctx;
@@ -1,8 +1,47 @@
 HEADERS += \
 	$$PWD/redisqtadapter.h \
+	$$PWD/qredisreplybuilder.h \
+	$$PWD/qrediscommands.h \
+	$$PWD/qrediscodec.h \
+	$$PWD/qredisconnection.h \
 	$$PWD/qredisclient.h \
-	$$PWD/qredisrequest.h
+	$$PWD/qredisrequest.h \
+	$$PWD/qredisbulkrequest.h \
+	$$PWD/qredisbulkloader.h \
+	$$PWD/qredisdevicerequest.h \
+	$$PWD/qredistransaction.h \
+	$$PWD/qredisrecorder.h \
+	$$PWD/qrediskeysampler.h \
+	$$PWD/qredisshardedclient.h \
+	$$PWD/qredismultikeyreply.h \
+	$$PWD/qredisshardedrequest.h \
+	$$PWD/qredisreplicatedclient.h \
+	$$PWD/qredisreplicatedrequest.h \
+	$$PWD/qredisstreamentry.h \
+	$$PWD/qredisstreamconsumer.h \
+	$$PWD/qredisscanner.h \
+	$$PWD/qredispatternmatcher.h \
+	$$PWD/qredissubscriber.h
 
 SOURCES += \
+	$$PWD/qredisreplybuilder.cpp \
+	$$PWD/qrediscommands.cpp \
+	$$PWD/qrediscodec.cpp \
+	$$PWD/qredisconnection.cpp \
 	$$PWD/qredisclient.cpp \
-	$$PWD/qredisrequest.cpp
+	$$PWD/qredisrequest.cpp \
+	$$PWD/qredisbulkrequest.cpp \
+	$$PWD/qredisbulkloader.cpp \
+	$$PWD/qredisdevicerequest.cpp \
+	$$PWD/qredistransaction.cpp \
+	$$PWD/qredisrecorder.cpp \
+	$$PWD/qrediskeysampler.cpp \
+	$$PWD/qredisshardedclient.cpp \
+	$$PWD/qredismultikeyreply.cpp \
+	$$PWD/qredisshardedrequest.cpp \
+	$$PWD/qredisreplicatedclient.cpp \
+	$$PWD/qredisreplicatedrequest.cpp \
+	$$PWD/qredisstreamconsumer.cpp \
+	$$PWD/qredisscanner.cpp \
+	$$PWD/qredispatternmatcher.cpp \
+	$$PWD/qredissubscriber.cpp
@@ -0,0 +1,381 @@
+#include "fakeredisserver.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+FakeRedisServer::FakeRedisServer(QObject *parent) :
+	QObject(parent),
+	fragment(false),
+	bandwidth(0)
+{
+	server = new QTcpServer(this);
+	connect(server, SIGNAL(newConnection()), SLOT(server_newConnection()));
+
+	clock.start();
+}
+
+FakeRedisServer::~FakeRedisServer()
+{
+	disconnectAll();
+}
+
+bool FakeRedisServer::listen(quint16 port)
+{
+	return server->listen(QHostAddress::LocalHost, port);
+}
+
+quint16 FakeRedisServer::port() const
+{
+	return server->serverPort();
+}
+
+void FakeRedisServer::setResponse(const QByteArray &command, const QByteArray &resp)
+{
+	responses[command.toUpper()] = resp;
+}
+
+void FakeRedisServer::setDelay(const QByteArray &command, int msecs)
+{
+	delays[command.toUpper()] = msecs;
+}
+
+void FakeRedisServer::setFragmentationEnabled(bool enabled)
+{
+	fragment = enabled;
+}
+
+void FakeRedisServer::disconnectMidReply(const QByteArray &command, int afterBytes)
+{
+	cuts[command.toUpper()] = afterBytes;
+}
+
+void FakeRedisServer::setBandwidth(int bytesPerSecond)
+{
+	bandwidth = bytesPerSecond;
+}
+
+void FakeRedisServer::disconnectAll()
+{
+	while(!conns.isEmpty())
+	{
+		QTcpSocket *sock = conns.first()->sock;
+		removeConnection(conns.first());
+		sock->abort();
+	}
+}
+
+int FakeRedisServer::connectionCount() const
+{
+	return conns.count();
+}
+
+int FakeRedisServer::commandCount(const QByteArray &command) const
+{
+	return counts.value(command.toUpper());
+}
+
+QByteArray FakeRedisServer::status(const QByteArray &s)
+{
+	return "+" + s + "\r\n";
+}
+
+QByteArray FakeRedisServer::error(const QByteArray &s)
+{
+	return "-" + s + "\r\n";
+}
+
+QByteArray FakeRedisServer::integer(qint64 i)
+{
+	return ":" + QByteArray::number(i) + "\r\n";
+}
+
+QByteArray FakeRedisServer::bulk(const QByteArray &s)
+{
+	return "$" + QByteArray::number(s.size()) + "\r\n" + s + "\r\n";
+}
+
+QByteArray FakeRedisServer::nil()
+{
+	return "$-1\r\n";
+}
+
+QByteArray FakeRedisServer::array(const QList<QByteArray> &items)
+{
+	QByteArray out = "*" + QByteArray::number(items.count()) + "\r\n";
+	foreach(const QByteArray &i, items)
+		out += bulk(i);
+	return out;
+}
+
+FakeRedisServer::Connection *FakeRedisServer::connectionForSocket(QObject *sock) const
+{
+	foreach(Connection *c, conns)
+	{
+		if(c->sock == sock)
+			return c;
+	}
+
+	return 0;
+}
+
+FakeRedisServer::Connection *FakeRedisServer::connectionForTimer(QObject *timer) const
+{
+	foreach(Connection *c, conns)
+	{
+		if(c->timer == timer)
+			return c;
+	}
+
+	return 0;
+}
+
+void FakeRedisServer::removeConnection(Connection *c)
+{
+	conns.removeAll(c);
+	// may be called from a slot of either
+	c->sock->disconnect(this);
+	c->sock->deleteLater();
+	c->timer->disconnect(this);
+	c->timer->deleteLater();
+	delete c;
+}
+
+// returns false if the buffer doesn't hold a complete command yet
+bool FakeRedisServer::parseCommand(QByteArray *buf, QList<QByteArray> *args)
+{
+	if(buf->isEmpty() || buf->at(0) != '*')
+		return false;
+
+	int at = buf->indexOf("\r\n");
+	if(at == -1)
+		return false;
+
+	int count = buf->mid(1, at - 1).toInt();
+	int pos = at + 2;
+
+	QList<QByteArray> out;
+	for(int n = 0; n < count; ++n)
+	{
+		at = buf->indexOf("\r\n", pos);
+		if(at == -1 || buf->at(pos) != '$')
+			return false;
+
+		int size = buf->mid(pos + 1, at - pos - 1).toInt();
+		pos = at + 2;
+		if(buf->size() < pos + size + 2)
+			return false;
+
+		out += buf->mid(pos, size);
+		pos += size + 2;
+	}
+
+	*buf = buf->mid(pos);
+	*args = out;
+	return true;
+}
+
+QByteArray FakeRedisServer::execute(const QList<QByteArray> &args)
+{
+	QByteArray cmd = args[0].toUpper();
+
+	if(responses.contains(cmd))
+		return responses.value(cmd);
+
+	if(cmd == "PING")
+		return status("PONG");
+	else if(cmd == "ECHO" && args.count() == 2)
+		return bulk(args[1]);
+	else if(cmd == "AUTH" || cmd == "SELECT" || cmd == "CLIENT")
+		return status("OK");
+	else if(cmd == "FLUSHALL" || cmd == "FLUSHDB")
+	{
+		strings.clear();
+		lists.clear();
+		return status("OK");
+	}
+	else if(cmd == "SET" && args.count() >= 3)
+	{
+		lists.remove(args[1]);
+		strings[args[1]] = args[2];
+		return status("OK");
+	}
+	else if(cmd == "GET" && args.count() == 2)
+	{
+		if(!strings.contains(args[1]))
+			return nil();
+		return bulk(strings.value(args[1]));
+	}
+	else if(cmd == "INCR" && args.count() == 2)
+	{
+		qint64 i = strings.value(args[1]).toLongLong() + 1;
+		strings[args[1]] = QByteArray::number(i);
+		return integer(i);
+	}
+	else if(cmd == "DEL" && args.count() >= 2)
+	{
+		int removed = 0;
+		for(int n = 1; n < args.count(); ++n)
+			removed += strings.remove(args[n]) + lists.remove(args[n]);
+		return integer(removed);
+	}
+	else if(cmd == "RPUSH" && args.count() >= 3)
+	{
+		QList<QByteArray> &l = lists[args[1]];
+		l += args.mid(2);
+		return integer(l.count());
+	}
+	else if(cmd == "LRANGE" && args.count() == 4)
+	{
+		QList<QByteArray> l = lists.value(args[1]);
+		int start = args[2].toInt();
+		int stop = args[3].toInt();
+		if(start < 0)
+			start = qMax(l.count() + start, 0);
+		if(stop < 0)
+			stop = l.count() + stop;
+		stop = qMin(stop, l.count() - 1);
+
+		return array(start <= stop ? l.mid(start, stop - start + 1) : QList<QByteArray>());
+	}
+
+	return error("ERR unknown command '" + args[0] + "'");
+}
+
+void FakeRedisServer::pump(Connection *c)
+{
+	while(!c->out.isEmpty())
+	{
+		Output &o = c->out.first();
+
+		qint64 now = clock.elapsed();
+		if(o.readyAt > now)
+		{
+			c->timer->start(o.readyAt - now);
+			return;
+		}
+
+		int n = o.data.size() - o.pos;
+		if(fragment)
+			n = 1;
+		if(o.cutAt >= 0)
+			n = qMin(n, o.cutAt - o.pos);
+
+		if(bandwidth > 0)
+		{
+			// a 50ms burst at most
+			c->tokens = qMin(c->tokens + (now - c->lastRefill) * bandwidth / 1000.0, qMax(bandwidth / 20.0, 1.0));
+			c->lastRefill = now;
+
+			if(c->tokens < 1)
+			{
+				c->timer->start(qMax((int)((1 - c->tokens) * 1000 / bandwidth), 1));
+				return;
+			}
+
+			n = qMin(n, (int)c->tokens);
+			c->tokens -= n;
+		}
+
+		c->sock->write(o.data.constData() + o.pos, n);
+		c->sock->flush();
+		o.pos += n;
+
+		if(o.cutAt >= 0 && o.pos >= o.cutAt)
+		{
+			QTcpSocket *sock = c->sock;
+			removeConnection(c);
+			sock->abort();
+			return;
+		}
+
+		if(o.pos == o.data.size())
+			c->out.removeFirst();
+
+		// give the client a chance to read each piece on its own
+		if(fragment || bandwidth > 0)
+		{
+			c->timer->start(0);
+			return;
+		}
+	}
+}
+
+void FakeRedisServer::server_newConnection()
+{
+	while(server->hasPendingConnections())
+	{
+		Connection *c = new Connection;
+		c->sock = server->nextPendingConnection();
+		c->timer = new QTimer(this);
+		c->timer->setSingleShot(true);
+		c->tokens = 0;
+		c->lastRefill = clock.elapsed();
+		connect(c->sock, SIGNAL(readyRead()), SLOT(sock_readyRead()));
+		connect(c->sock, SIGNAL(disconnected()), SLOT(sock_disconnected()));
+		connect(c->timer, SIGNAL(timeout()), SLOT(timer_timeout()));
+		conns += c;
+	}
+}
+
+void FakeRedisServer::sock_readyRead()
+{
+	QTcpSocket *sock = (QTcpSocket *)sender();
+	Connection *c = connectionForSocket(sock);
+	if(!c)
+		return;
+
+	c->in += c->sock->readAll();
+
+	QList<QByteArray> args;
+	while(parseCommand(&c->in, &args))
+	{
+		if(args.isEmpty())
+			continue;
+
+		QByteArray cmd = args[0].toUpper();
+		++counts[cmd];
+
+		emit commandReceived(args);
+
+		// a slot may have dropped the connection. the socket is deleted
+		//   later, so it can still be looked up
+		c = connectionForSocket(sock);
+		if(!c)
+			return;
+
+		Output o;
+		o.data = execute(args);
+		o.pos = 0;
+		o.cutAt = -1;
+		if(cuts.contains(cmd))
+		{
+			int at = cuts.take(cmd);
+			o.cutAt = (at >= 0 ? qMin(at, o.data.size()) : o.data.size() / 2);
+		}
+
+		// keep replies in order
+		o.readyAt = clock.elapsed() + delays.value(cmd);
+		if(!c->out.isEmpty())
+			o.readyAt = qMax(o.readyAt, c->out.last().readyAt);
+
+		c->out += o;
+	}
+
+	if(!c->timer->isActive())
+		pump(c);
+}
+
+void FakeRedisServer::sock_disconnected()
+{
+	Connection *c = connectionForSocket(sender());
+	if(c)
+		removeConnection(c);
+}
+
+void FakeRedisServer::timer_timeout()
+{
+	Connection *c = connectionForTimer(sender());
+	if(c)
+		pump(c);
+}
@@ -0,0 +1,109 @@
+#ifndef FAKEREDISSERVER_H
+#define FAKEREDISSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+// a small RESP server running in the test process. it keeps string and
+//   list keys in memory, and its replies can be scripted, delayed,
+//   fragmented, throttled or cut off
+class FakeRedisServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	FakeRedisServer(QObject *parent = 0);
+	~FakeRedisServer();
+
+	// zero picks a free port
+	bool listen(quint16 port = 0);
+	quint16 port() const;
+
+	// replies to the command with this raw RESP data instead of running it
+	void setResponse(const QByteArray &command, const QByteArray &resp);
+
+	// replies to the command are held back this long. replies on a
+	//   connection stay in order, so later replies wait behind them
+	void setDelay(const QByteArray &command, int msecs);
+
+	// replies are written one byte per event loop pass
+	void setFragmentationEnabled(bool enabled);
+
+	// the next reply to the command is cut off after this many bytes and
+	//   the connection is reset. -1 means half of the reply
+	void disconnectMidReply(const QByteArray &command, int afterBytes = -1);
+
+	// bytes per second for each connection. zero means unlimited
+	void setBandwidth(int bytesPerSecond);
+
+	// resets all client connections
+	void disconnectAll();
+
+	int connectionCount() const;
+	int commandCount(const QByteArray &command) const;
+
+	static QByteArray status(const QByteArray &s);
+	static QByteArray error(const QByteArray &s);
+	static QByteArray integer(qint64 i);
+	static QByteArray bulk(const QByteArray &s);
+	static QByteArray nil();
+	static QByteArray array(const QList<QByteArray> &items);
+
+signals:
+	void commandReceived(const QList<QByteArray> &args);
+
+private:
+	class Output
+	{
+	public:
+		QByteArray data;
+		int pos;
+		int cutAt; // -1 if not cut
+		qint64 readyAt;
+	};
+
+	class Connection
+	{
+	public:
+		QTcpSocket *sock;
+		QByteArray in;
+		QList<Output> out;
+		QTimer *timer;
+		double tokens;
+		qint64 lastRefill;
+	};
+
+	QTcpServer *server;
+	QList<Connection*> conns;
+	QElapsedTimer clock;
+	QHash<QByteArray, QByteArray> responses;
+	QHash<QByteArray, int> delays;
+	QHash<QByteArray, int> cuts;
+	QHash<QByteArray, int> counts;
+	bool fragment;
+	int bandwidth;
+	QHash<QByteArray, QByteArray> strings;
+	QHash<QByteArray, QList<QByteArray> > lists;
+
+	Connection *connectionForSocket(QObject *sock) const;
+	Connection *connectionForTimer(QObject *timer) const;
+	void removeConnection(Connection *c);
+	bool parseCommand(QByteArray *buf, QList<QByteArray> *args);
+	QByteArray execute(const QList<QByteArray> &args);
+	void pump(Connection *c);
+
+private slots:
+	void server_newConnection();
+	void sock_readyRead();
+	void sock_disconnected();
+	void timer_timeout();
+};
+
+#endif
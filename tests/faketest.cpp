@@ -0,0 +1,287 @@
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredisbulkrequest.h"
+#include "qredisshardedclient.h"
+#include "qredisshardedrequest.h"
+#include "fakeredisserver.h"
+
+Q_DECLARE_METATYPE(QRedis::Reply)
+
+// runs against an in-process server, so no redis is needed
+class FakeTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	FakeRedisServer *server;
+	QRedis::Client *client;
+
+	void wait(int ms)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		while(true)
+		{
+			QCoreApplication::processEvents(QEventLoop::AllEvents, ms);
+			ms -= timer.elapsed();
+			if(ms <= 0)
+				break;
+		}
+	}
+
+	void waitForSignal(QSignalSpy *spy)
+	{
+		while(spy->isEmpty())
+			wait(10);
+	}
+
+	QRedis::Reply waitForReply(QRedis::Request *r)
+	{
+		QSignalSpy spy(r, SIGNAL(readyRead(const QRedis::Reply &)));
+		waitForSignal(&spy);
+
+		return spy.takeFirst().first().value<QRedis::Reply>();
+	}
+
+	QRedis::Reply command(const QList<QByteArray> &args)
+	{
+		QRedis::Request *req = client->createRequest();
+		req->start(args);
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		return rep;
+	}
+
+private slots:
+	void initTestCase()
+	{
+		qRegisterMetaType<QRedis::Reply>();
+	}
+
+	void init()
+	{
+		server = new FakeRedisServer(this);
+		QVERIFY(server->listen());
+
+		client = new QRedis::Client(this);
+		client->connectToServer("127.0.0.1", server->port());
+
+		QSignalSpy spy(client, SIGNAL(connected()));
+		waitForSignal(&spy);
+	}
+
+	void cleanup()
+	{
+		delete client;
+		delete server;
+
+		QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+	}
+
+	void scripted()
+	{
+		server->setResponse("GET", FakeRedisServer::bulk("scripted"));
+
+		QRedis::Reply rep = command(QList<QByteArray>() << "GET" << "foo");
+		QCOMPARE(rep.value.toByteArray(), QByteArray("scripted"));
+	}
+
+	void delayed()
+	{
+		server->setDelay("GET", 200);
+
+		QRedis::Request *getReq = client->createRequest();
+		QRedis::Request *pingReq = client->createRequest();
+		QSignalSpy getSpy(getReq, SIGNAL(readyRead(const QRedis::Reply &)));
+		QSignalSpy pingSpy(pingReq, SIGNAL(readyRead(const QRedis::Reply &)));
+
+		QElapsedTimer timer;
+		timer.start();
+		getReq->get("foo");
+		pingReq->start("PING");
+		waitForSignal(&pingSpy);
+
+		// the reply behind the delayed one waits too
+		QVERIFY(timer.elapsed() >= 190);
+		QCOMPARE(getSpy.count(), 1);
+
+		delete getReq;
+		delete pingReq;
+	}
+
+	void deleteWithOutstanding()
+	{
+		server->setDelay("GET", 200);
+		client->setSingleFlightEnabled(true);
+
+		QRedis::Request *leaderReq = client->createRequest();
+		QRedis::Request *followerReq = client->createRequest();
+		QSignalSpy leaderSpy(leaderReq, SIGNAL(error()));
+		QSignalSpy followerSpy(followerReq, SIGNAL(error()));
+
+		leaderReq->get("foo");
+		followerReq->get("foo");
+		wait(50);
+
+		// the outstanding command fails without being replayed
+		delete client;
+		client = 0;
+		wait(10);
+
+		QCOMPARE(leaderSpy.count(), 1);
+		QCOMPARE(followerSpy.count(), 1);
+
+		delete leaderReq;
+		delete followerReq;
+	}
+
+	void setupFailed()
+	{
+		server->setResponse("AUTH", FakeRedisServer::error("WRONGPASS invalid password"));
+
+		QRedis::Client other;
+		other.setAuth("bad");
+		QSignalSpy spy(&other, SIGNAL(setupFailed(const QByteArray &)));
+		other.connectToServer("127.0.0.1", server->port());
+
+		// reported on every attempt
+		while(spy.count() < 2)
+			wait(10);
+
+		QCOMPARE(spy.first().first().toByteArray(), QByteArray("WRONGPASS invalid password"));
+	}
+
+	void shardErrors()
+	{
+		FakeRedisServer failing;
+		QVERIFY(failing.listen());
+		failing.setResponse("MSET", FakeRedisServer::error("ERR shard failed"));
+		failing.setResponse("DEL", FakeRedisServer::error("ERR shard failed"));
+		server->setResponse("MSET", FakeRedisServer::status("OK"));
+
+		QRedis::ShardedClient sc;
+		sc.addShard("a", "127.0.0.1", server->port());
+		sc.addShard("b", "127.0.0.1", failing.port());
+
+		QList<QPair<QByteArray, QByteArray> > pairs;
+		QList<QByteArray> keys;
+		for(int n = 0; n < 20; ++n)
+		{
+			keys += "key" + QByteArray::number(n);
+			pairs += qMakePair(keys.last(), QByteArray("x"));
+		}
+
+		// a failed part is reported, not merged away
+		QRedis::ShardedRequest *req = sc.createRequest();
+		QSignalSpy spy(req, SIGNAL(readyRead(const QRedis::Reply &)));
+		req->mset(pairs);
+		waitForSignal(&spy);
+		QRedis::Reply rep = spy.takeFirst().first().value<QRedis::Reply>();
+		QVERIFY(rep.error);
+		QCOMPARE(rep.value.toByteArray(), QByteArray("ERR shard failed"));
+
+		req->del(keys);
+		waitForSignal(&spy);
+		rep = spy.takeFirst().first().value<QRedis::Reply>();
+		QVERIFY(rep.error);
+		delete req;
+	}
+
+	void bulkErrors()
+	{
+		server->setResponse("MSET", FakeRedisServer::error("ERR chunk failed"));
+
+		QList<QPair<QByteArray, QByteArray> > pairs;
+		for(int n = 0; n < 20; ++n)
+			pairs += qMakePair("key" + QByteArray::number(n), QByteArray("x"));
+
+		QRedis::BulkRequest *req = client->createBulkRequest();
+		req->setChunkSize(5);
+		req->setMaxChunksInFlight(1);
+		QSignalSpy spy(req, SIGNAL(readyRead(const QRedis::Reply &)));
+		req->mset(pairs);
+		waitForSignal(&spy);
+		delete req;
+
+		// the first failed chunk ends the request
+		QRedis::Reply rep = spy.takeFirst().first().value<QRedis::Reply>();
+		QVERIFY(rep.error);
+		QCOMPARE(rep.value.toByteArray(), QByteArray("ERR chunk failed"));
+		QCOMPARE(server->commandCount("MSET"), 1);
+	}
+
+	void fragmented()
+	{
+		server->setFragmentationEnabled(true);
+
+		QList<QByteArray> args;
+		args << "RPUSH" << "list1";
+		for(int n = 0; n < 100; ++n)
+			args += QByteArray::number(n);
+		command(args);
+
+		QRedis::Reply rep = command(QList<QByteArray>() << "LRANGE" << "list1" << "0" << "-1");
+		QVariantList l = rep.value.toList();
+		QCOMPARE(l.count(), 100);
+		for(int n = 0; n < l.count(); ++n)
+			QCOMPARE(l[n].toByteArray(), QByteArray::number(n));
+
+		QByteArray value(5000, 'x');
+		command(QList<QByteArray>() << "SET" << "key1" << value);
+		rep = command(QList<QByteArray>() << "GET" << "key1");
+		QCOMPARE(rep.value.toByteArray(), value);
+	}
+
+	void disconnectMidReply()
+	{
+		command(QList<QByteArray>() << "SET" << "key1" << QByteArray(1000, 'x'));
+
+		// the read is sent again after the client reconnects
+		server->disconnectMidReply("GET");
+		QRedis::Reply rep = command(QList<QByteArray>() << "GET" << "key1");
+		QCOMPARE(rep.value.toByteArray(), QByteArray(1000, 'x'));
+		QCOMPARE(client->retriedCount(), (qint64)1);
+		QCOMPARE(server->commandCount("GET"), 2);
+	}
+
+	void throttled()
+	{
+		QByteArray value(100000, 'x');
+		command(QList<QByteArray>() << "SET" << "key1" << value);
+
+		server->setBandwidth(200000);
+
+		QElapsedTimer timer;
+		timer.start();
+		QRedis::Reply rep = command(QList<QByteArray>() << "GET" << "key1");
+		QCOMPARE(rep.value.toByteArray(), value);
+		QVERIFY(timer.elapsed() >= 400);
+	}
+
+	void pipelineBenchmark()
+	{
+		command(QList<QByteArray>() << "SET" << "key1" << "value");
+
+		QBENCHMARK
+		{
+			QList<QRedis::Request*> reqs;
+			for(int n = 0; n < 1000; ++n)
+			{
+				QRedis::Request *req = client->createRequest();
+				req->get("key1");
+				reqs += req;
+			}
+
+			// replies arrive in order
+			QSignalSpy spy(reqs.last(), SIGNAL(readyRead(const QRedis::Reply &)));
+			waitForSignal(&spy);
+			qDeleteAll(reqs);
+		}
+	}
+};
+
+QTEST_MAIN(FakeTest)
+#include "faketest.moc"
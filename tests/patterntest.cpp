@@ -0,0 +1,92 @@
+#include <QtTest/QtTest>
+#include "qredispatternmatcher.h"
+
+class PatternTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	static QList<int> sorted(QList<int> l)
+	{
+		qSort(l);
+		return l;
+	}
+
+private slots:
+	void globSyntax()
+	{
+		QRedis::PatternMatcher m;
+		m.insert(0, "user.*.events");
+		m.insert(1, "user.?.events");
+		m.insert(2, "user.[a-c].events");
+		m.insert(3, "user.[^a].events");
+		m.insert(4, "user.\\*.events");
+		m.insert(5, "user.a.events");
+		m.insert(6, "*");
+
+		QCOMPARE(sorted(m.match("user.a.events")), QList<int>() << 0 << 1 << 2 << 5 << 6);
+		QCOMPARE(sorted(m.match("user.d.events")), QList<int>() << 0 << 1 << 3 << 6);
+		QCOMPARE(sorted(m.match("user.*.events")), QList<int>() << 0 << 1 << 3 << 4 << 6);
+		QCOMPARE(sorted(m.match("user.abc.events")), QList<int>() << 0 << 6);
+		QCOMPARE(sorted(m.match("user..events")), QList<int>() << 0 << 6);
+		QCOMPARE(sorted(m.match("user.a.eventsx")), QList<int>() << 6);
+
+		m.remove(6);
+		m.remove(5);
+		QCOMPARE(sorted(m.match("user.a.events")), QList<int>() << 0 << 1 << 2);
+		QVERIFY(m.match("other").isEmpty());
+
+		QCOMPARE(QRedis::PatternMatcher::literalPrefix("user.\\*x*.events"), QByteArray("user.*x"));
+		QVERIFY(!QRedis::PatternMatcher::isPattern("user.a.events"));
+	}
+
+	void backtracking()
+	{
+		QRedis::PatternMatcher m;
+		m.insert(0, "a*b*c");
+		m.insert(1, "*abc");
+
+		QCOMPARE(sorted(m.match("aXbYbZc")), QList<int>() << 0);
+		QCOMPARE(sorted(m.match("abababc")), QList<int>() << 0 << 1);
+		QVERIFY(m.match("aXbYbZ").isEmpty());
+	}
+
+	void dispatchBenchmark()
+	{
+		QRedis::PatternMatcher m;
+		for(int n = 0; n < 10000; ++n)
+		{
+			QByteArray num = QByteArray::number(n);
+			if(n % 4 == 0)
+				m.insert(n, "user." + num + ".*.events");
+			else if(n % 4 == 1)
+				m.insert(n, "user.*." + num + ".events");
+			else if(n % 4 == 2)
+				m.insert(n, "svc." + num + ".?");
+			else
+				m.insert(n, "exact." + num);
+		}
+
+		QList<QByteArray> channels;
+		for(int n = 0; n < 1000; ++n)
+		{
+			channels += "user." + QByteArray::number(n * 4) + ".login.events";
+			channels += "svc." + QByteArray::number(n * 4 + 2) + ".x";
+			channels += "exact." + QByteArray::number(n * 4 + 3);
+		}
+
+		int total = 0;
+		QBENCHMARK
+		{
+			total = 0;
+			foreach(const QByteArray &c, channels)
+				total += m.match(c).count();
+		}
+
+		// each channel matches exactly one pattern
+		QCOMPARE(total, channels.count());
+	}
+};
+
+QTEST_MAIN(PatternTest)
+#include "patterntest.moc"
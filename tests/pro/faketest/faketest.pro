@@ -0,0 +1,5 @@
+include(../../tests.pri)
+HEADERS += $$TESTS_DIR/fakeredisserver.h
+SOURCES += \
+	$$TESTS_DIR/fakeredisserver.cpp \
+	$$TESTS_DIR/faketest.cpp
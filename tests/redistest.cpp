@@ -3,8 +3,60 @@
 #include "qredisclient.h"
 #include "qredisrequest.h"
 #include "qredisreply.h"
+#include "qredisbulkrequest.h"
+#include "qredisbulkloader.h"
+#include "qredisdevicerequest.h"
+#include "qredistransaction.h"
+#include "qredisrecorder.h"
+#include "qredisshardedclient.h"
+#include "qredisshardedrequest.h"
+#include "qredisreplicatedclient.h"
+#include "qredisreplicatedrequest.h"
+#include "qredisstreamconsumer.h"
+#include "qredisscanner.h"
+#include "qredissubscriber.h"
 
 Q_DECLARE_METATYPE(QRedis::Reply)
+Q_DECLARE_METATYPE(QList<QRedis::StreamEntry>)
+Q_DECLARE_METATYPE(QList<QRedis::Reply>)
+
+class MessageSink : public QObject
+{
+	Q_OBJECT
+
+public:
+	QList<QByteArray> channels;
+
+public slots:
+	void message(const QByteArray &channel, const QByteArray &message)
+	{
+		Q_UNUSED(message);
+
+		channels += channel;
+	}
+};
+
+class CounterSource : public QRedis::BulkRecordSource
+{
+public:
+	int next;
+	int count;
+
+	CounterSource(int _count) :
+		next(0),
+		count(_count)
+	{
+	}
+
+	virtual bool nextRecord(QList<QByteArray> *args)
+	{
+		if(next >= count)
+			return false;
+
+		*args = QList<QByteArray>() << "RPUSH" << "test-load-list" << QByteArray::number(next++);
+		return true;
+	}
+};
 
 class RedisTest : public QObject
 {
@@ -40,10 +92,44 @@ private:
 		return spy.takeFirst().first().value<QRedis::Reply>();
 	}
 
+	QRedis::Reply waitForReply(QRedis::BulkRequest *r)
+	{
+		QSignalSpy spy(r, SIGNAL(readyRead(const QRedis::Reply &)));
+		waitForSignal(&spy);
+
+		return spy.takeFirst().first().value<QRedis::Reply>();
+	}
+
+	QRedis::Reply waitForReply(QRedis::DeviceRequest *r)
+	{
+		QSignalSpy spy(r, SIGNAL(readyRead(const QRedis::Reply &)));
+		waitForSignal(&spy);
+
+		return spy.takeFirst().first().value<QRedis::Reply>();
+	}
+
+	QRedis::Reply waitForReply(QRedis::ShardedRequest *r)
+	{
+		QSignalSpy spy(r, SIGNAL(readyRead(const QRedis::Reply &)));
+		waitForSignal(&spy);
+
+		return spy.takeFirst().first().value<QRedis::Reply>();
+	}
+
+	QRedis::Reply waitForReply(QRedis::ReplicatedRequest *r)
+	{
+		QSignalSpy spy(r, SIGNAL(readyRead(const QRedis::Reply &)));
+		waitForSignal(&spy);
+
+		return spy.takeFirst().first().value<QRedis::Reply>();
+	}
+
 private slots:
 	void initTestCase()
 	{
 		qRegisterMetaType<QRedis::Reply>();
+		qRegisterMetaType<QList<QRedis::StreamEntry> >();
+		qRegisterMetaType<QList<QRedis::Reply> >();
 
 		client = new QRedis::Client(this);
 		client->connectToServer("localhost", 6379);
@@ -78,6 +164,937 @@ private slots:
 		delete req;
 		QCOMPARE(rep.value.toInt(), 1);
 	}
+
+	void handshake()
+	{
+		QRedis::Client c;
+		c.setDatabase(1);
+		c.setClientName("qredis-test");
+		c.connectToServer("localhost", 6379);
+
+		// queued before the connection is set up
+		QRedis::Request *req = c.createRequest();
+		req->start("CLIENT", "GETNAME");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("qredis-test"));
+
+		req = c.createRequest();
+		req->set("test-handshake", "db1");
+		waitForReply(req);
+		delete req;
+
+		// not visible in db 0
+		req = client->createRequest();
+		req->get("test-handshake");
+		rep = waitForReply(req);
+		delete req;
+		QVERIFY(rep.value.isNull());
+
+		req = c.createRequest();
+		req->del("test-handshake");
+		waitForReply(req);
+		delete req;
+	}
+
+	void retryAfterReconnect()
+	{
+		QRedis::Client c;
+		c.connectToServer("localhost", 6379);
+
+		QRedis::Request *req = c.createRequest();
+		req->start("CLIENT", "ID");
+		QByteArray id = QByteArray::number(waitForReply(req).value.toLongLong());
+		delete req;
+
+		req = client->createRequest();
+		req->set("test-retry", "still here");
+		waitForReply(req);
+		delete req;
+
+		// the GET is pipelined behind a command that drops the connection
+		QRedis::Request *killReq = c.createRequest();
+		killReq->start("CLIENT", "KILL", "ID", id, "SKIPME", "no");
+		req = c.createRequest();
+		req->get("test-retry");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		delete killReq;
+
+		QCOMPARE(rep.value.toByteArray(), QByteArray("still here"));
+		QCOMPARE(c.retriedCount(), (qint64)1);
+
+		req = client->createRequest();
+		req->del("test-retry");
+		waitForReply(req);
+		delete req;
+	}
+
+	void cancel()
+	{
+		qint64 unsent = client->unsentCount();
+
+		// not yet written, so never sent
+		QRedis::Request *req = client->createRequest();
+		req->get("test-cancel");
+		req->cancel();
+		delete req;
+		QCOMPARE(client->unsentCount(), unsent + 1);
+
+		QRedis::Client c;
+		c.connectToServer("localhost", 6379);
+
+		req = c.createRequest();
+		req->start("SUBSCRIBE", "test-cancel-channel");
+		waitForReply(req);
+		delete req;
+
+		// the subscription is dropped on the server as well
+		QElapsedTimer timer;
+		timer.start();
+		int subscribers = -1;
+		while(subscribers != 0 && timer.elapsed() < 2000)
+		{
+			req = client->createRequest();
+			req->start("PUBSUB", "NUMSUB", "test-cancel-channel");
+			subscribers = waitForReply(req).value.toList().value(1).toInt();
+			delete req;
+		}
+
+		QCOMPARE(subscribers, 0);
+	}
+
+	void nonBlockingResolve()
+	{
+		// the lookup of a bad name must not hold up the event loop
+		QRedis::Client c;
+		QElapsedTimer timer;
+		timer.start();
+		c.connectToServer("qredis-test.invalid", 6379);
+		QVERIFY(timer.elapsed() < 100);
+
+		QRedis::Request *req = client->createRequest();
+		req->start("PING");
+		waitForReply(req);
+		delete req;
+		QVERIFY(c.getContext() == 0);
+	}
+
+	void arrays()
+	{
+		QRedis::Request *req = client->createRequest();
+		req->start("EVAL", "return {1, {'a', {}, 'b'}, 'c'}", "0");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+
+		QVariantList l = rep.value.toList();
+		QCOMPARE(l.count(), 3);
+		QCOMPARE(l[0].toInt(), 1);
+		QCOMPARE(l[2].toByteArray(), QByteArray("c"));
+
+		QVariantList sub = l[1].toList();
+		QCOMPARE(sub.count(), 3);
+		QCOMPARE(sub[0].toByteArray(), QByteArray("a"));
+		QCOMPARE(sub[1].type(), QVariant::List);
+		QVERIFY(sub[1].toList().isEmpty());
+		QCOMPARE(sub[2].toByteArray(), QByteArray("b"));
+	}
+
+	void lrangeBenchmark()
+	{
+		QList<QByteArray> args;
+		args << "RPUSH" << "test-list1";
+		for(int n = 0; n < 1000; ++n)
+			args += QByteArray::number(n);
+
+		QRedis::Request *req = client->createRequest();
+		req->start(args);
+		waitForReply(req);
+		delete req;
+
+		QBENCHMARK
+		{
+			req = client->createRequest();
+			req->start("LRANGE", "test-list1", "0", "1000");
+			QRedis::Reply rep = waitForReply(req);
+			delete req;
+			QCOMPARE(rep.value.toList().count(), 1000);
+		}
+
+		req = client->createRequest();
+		req->del("test-list1");
+		waitForReply(req);
+		delete req;
+	}
+
+	void chunkedReply()
+	{
+		QList<QByteArray> args;
+		args << "RPUSH" << "test-list2";
+		for(int n = 0; n < 50000; ++n)
+			args += QByteArray::number(n);
+
+		QRedis::Request *req = client->createRequest();
+		req->start(args);
+		waitForReply(req);
+		delete req;
+
+		req = client->createRequest();
+		req->setChunkSize(1000);
+		QSignalSpy chunkSpy(req, SIGNAL(chunkReady(const QVariantList &)));
+		req->start("LRANGE", "test-list2", "0", "-1");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+
+		QCOMPARE(rep.value.toInt(), 50000);
+
+		int next = 0;
+		for(int n = 0; n < chunkSpy.count(); ++n)
+		{
+			QVariantList elements = chunkSpy[n].first().toList();
+			QVERIFY(elements.count() <= 1000);
+			foreach(const QVariant &v, elements)
+				QCOMPARE(v.toInt(), next++);
+		}
+		QCOMPARE(next, 50000);
+
+		req = client->createRequest();
+		req->del("test-list2");
+		waitForReply(req);
+		delete req;
+	}
+
+	void singleFlight()
+	{
+		QRedis::Request *req = client->createRequest();
+		req->set("test-key2", "qredis-flight");
+		waitForReply(req);
+		delete req;
+
+		client->setSingleFlightEnabled(true);
+		qint64 before = client->collapsedCount();
+
+		QList<QRedis::Request*> reqs;
+		QList<QSignalSpy*> spies;
+		for(int n = 0; n < 10; ++n)
+		{
+			req = client->createRequest();
+			spies += new QSignalSpy(req, SIGNAL(readyRead(const QRedis::Reply &)));
+			req->get("test-key2");
+			reqs += req;
+		}
+
+		// deleting the leader must not strand the others
+		delete reqs.takeFirst();
+		delete spies.takeFirst();
+
+		for(int n = 0; n < spies.count(); ++n)
+		{
+			waitForSignal(spies[n]);
+			QRedis::Reply rep = spies[n]->takeFirst().first().value<QRedis::Reply>();
+			QCOMPARE(rep.value.toByteArray(), QByteArray("qredis-flight"));
+		}
+
+		QCOMPARE(client->collapsedCount() - before, (qint64)9);
+
+		qDeleteAll(spies);
+		qDeleteAll(reqs);
+		client->setSingleFlightEnabled(false);
+
+		req = client->createRequest();
+		req->del("test-key2");
+		waitForReply(req);
+		delete req;
+	}
+
+	void priorityLanes()
+	{
+		QByteArray value(32 * 1024 * 1024, 'x');
+		QRedis::Request *req = client->createRequest();
+		req->set("test-lane-big", value);
+		waitForReply(req);
+		delete req;
+
+		QRedis::Client laneClient;
+		laneClient.setPriorityLanesEnabled(true);
+		QSignalSpy connectedSpy(&laneClient, SIGNAL(connected()));
+		laneClient.connectToServer("localhost", 6379);
+		waitForSignal(&connectedSpy);
+
+		// the large reply takes many reads to arrive
+		QRedis::Request *lowReq = laneClient.createRequest();
+		lowReq->setPriority(QRedis::Request::LowPriority);
+		QSignalSpy lowSpy(lowReq, SIGNAL(readyRead(const QRedis::Reply &)));
+		lowReq->get("test-lane-big");
+
+		req = laneClient.createRequest();
+		req->setPriority(QRedis::Request::HighPriority);
+		req->start("PING");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("PONG"));
+
+		// the high priority reply didn't wait for the low one
+		QVERIFY(lowSpy.isEmpty());
+
+		waitForSignal(&lowSpy);
+		rep = lowSpy.takeFirst().first().value<QRedis::Reply>();
+		delete lowReq;
+		QCOMPARE(rep.value.toByteArray().size(), value.size());
+
+		req = client->createRequest();
+		req->del("test-lane-big");
+		waitForReply(req);
+		delete req;
+	}
+
+	void blockingLease()
+	{
+		QRedis::Request *blockReq = client->createRequest();
+		QSignalSpy blockSpy(blockReq, SIGNAL(readyRead(const QRedis::Reply &)));
+		blockReq->start("BLPOP", "test-lease-list", "1");
+
+		QRedis::Request *req = client->createRequest();
+		req->start("PING");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+
+		// the ping must not have waited behind the blocked pop
+		QVERIFY(blockSpy.isEmpty());
+		QCOMPARE(rep.value.toByteArray(), QByteArray("PONG"));
+
+		req = client->createRequest();
+		req->start("RPUSH", "test-lease-list", "item");
+		waitForReply(req);
+		delete req;
+
+		waitForSignal(&blockSpy);
+		rep = blockSpy.takeFirst().first().value<QRedis::Reply>();
+		delete blockReq;
+		QCOMPARE(rep.value.toList().value(1).toByteArray(), QByteArray("item"));
+	}
+
+	void streamConsumer()
+	{
+		QRedis::Request *req = client->createRequest();
+		req->start("XGROUP", "CREATE", "test-stream1", "group1", "$", "MKSTREAM");
+		waitForReply(req);
+		delete req;
+
+		for(int n = 0; n < 3; ++n)
+		{
+			req = client->createRequest();
+			req->start("XADD", "test-stream1", "*", "n", QByteArray::number(n));
+			waitForReply(req);
+			delete req;
+		}
+
+		QRedis::StreamConsumer consumer(client);
+		consumer.setGroup("group1", "consumer1");
+		consumer.setStreams(QList<QByteArray>() << "test-stream1");
+		consumer.setBlockTimeout(100);
+		consumer.setAckInterval(10);
+		QSignalSpy spy(&consumer, SIGNAL(entriesReady(const QList<QRedis::StreamEntry> &)));
+		consumer.start();
+
+		QList<QRedis::StreamEntry> entries;
+		while(entries.count() < 3)
+		{
+			waitForSignal(&spy);
+			entries += spy.takeFirst().first().value<QList<QRedis::StreamEntry> >();
+		}
+
+		for(int n = 0; n < entries.count(); ++n)
+		{
+			QCOMPARE(entries[n].stream, QByteArray("test-stream1"));
+			QCOMPARE(entries[n].fields.count(), 1);
+			QCOMPARE(entries[n].fields[0].second, QByteArray::number(n));
+			consumer.ack(entries[n]);
+		}
+
+		consumer.stop();
+		wait(100);
+
+		req = client->createRequest();
+		req->start("XPENDING", "test-stream1", "group1");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toList().value(0).toInt(), 0);
+
+		req = client->createRequest();
+		req->del("test-stream1");
+		waitForReply(req);
+		delete req;
+	}
+
+	void scanner()
+	{
+		QList<QByteArray> args;
+		args << "HSET" << "test-scan1";
+		for(int n = 0; n < 1000; ++n)
+			args << ("f" + QByteArray::number(n)) << QByteArray::number(n);
+
+		QRedis::Request *req = client->createRequest();
+		req->start(args);
+		waitForReply(req);
+		delete req;
+
+		QRedis::Scanner scanner(client);
+		scanner.setCount(100);
+		QSignalSpy itemsSpy(&scanner, SIGNAL(itemsReady(const QList<QByteArray> &)));
+		QSignalSpy finishedSpy(&scanner, SIGNAL(finished()));
+		scanner.hscan("test-scan1");
+		waitForSignal(&finishedSpy);
+
+		QHash<QByteArray, QByteArray> fields;
+		for(int n = 0; n < itemsSpy.count(); ++n)
+		{
+			QList<QByteArray> items = itemsSpy[n].first().value<QList<QByteArray> >();
+			QVERIFY(items.count() % 2 == 0);
+			for(int i = 0; i < items.count(); i += 2)
+			{
+				QVERIFY(!fields.contains(items[i]));
+				fields.insert(items[i], items[i + 1]);
+			}
+		}
+
+		QCOMPARE(fields.count(), 1000);
+		QCOMPARE(fields.value("f500"), QByteArray("500"));
+
+		req = client->createRequest();
+		req->del("test-scan1");
+		waitForReply(req);
+		delete req;
+	}
+
+	void shardedRing()
+	{
+		QRedis::ShardedClient sc;
+		sc.setHashTagsEnabled(true);
+		sc.addShard("a", "localhost", 6379);
+		sc.addShard("b", "localhost", 6379);
+		sc.addShard("c", "localhost", 6379);
+
+		QList<QByteArray> keys;
+		QStringList before;
+		for(int n = 0; n < 1000; ++n)
+		{
+			keys += "key" + QByteArray::number(n);
+			before += sc.shardForKey(keys.last());
+		}
+
+		QVERIFY(before.contains("a"));
+		QVERIFY(before.contains("b"));
+		QVERIFY(before.contains("c"));
+
+		QCOMPARE(sc.shardForKey("{user1}.name"), sc.shardForKey("user1"));
+
+		// only keys of the down shard should move
+		sc.setShardDown("b", true);
+		for(int n = 0; n < keys.count(); ++n)
+		{
+			QString s = sc.shardForKey(keys[n]);
+			QVERIFY(s != "b");
+			if(before[n] != "b")
+				QCOMPARE(s, before[n]);
+		}
+	}
+
+	void shardedMulti()
+	{
+		QRedis::ShardedClient sc;
+		sc.addShard("a", "localhost", 6379);
+		sc.addShard("b", "localhost", 6379);
+
+		QList<QPair<QByteArray, QByteArray> > pairs;
+		QList<QByteArray> keys;
+		for(int n = 0; n < 20; ++n)
+		{
+			keys += "test-shard" + QByteArray::number(n);
+			pairs += qMakePair(keys.last(), QByteArray::number(n));
+		}
+
+		QRedis::ShardedRequest *req = sc.createRequest();
+		req->mset(pairs);
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+
+		req = sc.createRequest();
+		req->mget(keys);
+		rep = waitForReply(req);
+		delete req;
+
+		QVariantList l = rep.value.toList();
+		QCOMPARE(l.count(), keys.count());
+		for(int n = 0; n < l.count(); ++n)
+			QCOMPARE(l[n].toByteArray(), QByteArray::number(n));
+
+		req = sc.createRequest();
+		req->del(keys);
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toInt(), keys.count());
+	}
+
+	// needs replicas of localhost:6379 on ports 6380 and 6381, for
+	//   example: redis-server --port 6380 --replicaof localhost 6379
+	void replicatedRouting()
+	{
+		QRedis::ReplicatedClient rc;
+		rc.setProbeInterval(100);
+		rc.addReplica("localhost", 6380);
+		rc.addReplica("localhost", 6381);
+		rc.connectToServer("localhost", 6379);
+
+		QElapsedTimer timer;
+		timer.start();
+		while(rc.clientForCommand("GET") == rc.primary() && timer.elapsed() < 3000)
+			wait(10);
+
+		if(rc.clientForCommand("GET") == rc.primary())
+			QSKIP("replicas not available");
+
+		QVERIFY(rc.clientForCommand("SET") == rc.primary());
+		QVERIFY(rc.replicaLatency("localhost:6380") >= 0);
+
+		QRedis::ReplicatedRequest *req = rc.createRequest();
+		req->set("test-replicated", "hi");
+		waitForReply(req);
+		delete req;
+
+		// sent on the connection that made the write, so it waits for it
+		QRedis::Request *wreq = rc.primary()->createRequest();
+		wreq->start("WAIT", "1", "1000");
+		QRedis::Reply wrep = waitForReply(wreq);
+		delete wreq;
+		QVERIFY(wrep.value.toLongLong() >= 1);
+
+		req = rc.createRequest();
+		req->get("test-replicated");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("hi"));
+
+		req = rc.createRequest();
+		req->del("test-replicated");
+		waitForReply(req);
+		delete req;
+	}
+
+	void subscriber()
+	{
+		QRedis::Subscriber sub(client);
+		MessageSink a, b, c;
+		sub.addListener("test-sub.*.events", &a, "message");
+		sub.addListener("test-sub.a.events", &b, "message");
+		sub.addListener("test-sub.[ab].*", &c, "message");
+
+		QSignalSpy subSpy(&sub, SIGNAL(subscribed()));
+		waitForSignal(&subSpy);
+
+		QList<QByteArray> channels;
+		channels << "test-sub.a.events" << "test-sub.b.other" << "test-sub.c.events";
+		foreach(const QByteArray &channel, channels)
+		{
+			QRedis::Request *req = client->createRequest();
+			req->start("PUBLISH", channel, "hi");
+			waitForReply(req);
+			delete req;
+		}
+
+		while(a.channels.count() < 2)
+			wait(10);
+
+		QCOMPARE(a.channels, QList<QByteArray>() << "test-sub.a.events" << "test-sub.c.events");
+		QCOMPARE(b.channels, QList<QByteArray>() << "test-sub.a.events");
+		QCOMPARE(c.channels, QList<QByteArray>() << "test-sub.a.events" << "test-sub.b.other");
+	}
+
+	void bulk()
+	{
+		QList<QPair<QByteArray, QByteArray> > pairs;
+		QList<QByteArray> keys;
+		for(int n = 0; n < 2500; ++n)
+		{
+			keys += "test-bulk" + QByteArray::number(n);
+			pairs += qMakePair(keys.last(), QByteArray::number(n));
+		}
+
+		QRedis::BulkRequest *req = client->createBulkRequest();
+		req->setChunkSize(100);
+		req->setMaxChunksInFlight(4);
+		req->mset(pairs);
+		waitForReply(req);
+		delete req;
+
+		req = client->createBulkRequest();
+		req->setChunkSize(100);
+		QSignalSpy progressSpy(req, SIGNAL(progress(int, int)));
+		req->mget(keys);
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+
+		QCOMPARE(progressSpy.count(), 25);
+		QVariantList l = rep.value.toList();
+		QCOMPARE(l.count(), keys.count());
+		for(int n = 0; n < l.count(); ++n)
+			QCOMPARE(l[n].toByteArray(), QByteArray::number(n));
+
+		req = client->createBulkRequest();
+		req->setChunkSize(100);
+		req->del(keys);
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toInt(), keys.count());
+	}
+
+	void device()
+	{
+		QByteArray data;
+		for(int n = 0; n < 300000; ++n)
+			data += (char)('a' + (n % 26));
+
+		QBuffer in(&data);
+		in.open(QIODevice::ReadOnly);
+
+		QRedis::DeviceRequest *req = client->createDeviceRequest();
+		req->setChunkSize(16384);
+		req->setMaxChunksInFlight(4);
+		QSignalSpy progressSpy(req, SIGNAL(progress(qint64, qint64)));
+		req->setFromDevice("test-device1", &in);
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("OK"));
+		QCOMPARE(progressSpy.count(), 19);
+
+		// the upload's expiry isn't carried over
+		QRedis::Request *treq = client->createRequest();
+		treq->start("PTTL", "test-device1");
+		rep = waitForReply(treq);
+		delete treq;
+		QCOMPARE(rep.value.toLongLong(), (qlonglong)-1);
+
+		QByteArray out;
+		QBuffer outBuf(&out);
+		outBuf.open(QIODevice::WriteOnly);
+
+		req = client->createDeviceRequest();
+		req->setChunkSize(16384);
+		req->getToDevice("test-device1", &outBuf);
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toLongLong(), (qlonglong)data.size());
+		QCOMPARE(out, data);
+
+		QRedis::Request *dreq = client->createRequest();
+		dreq->del("test-device1");
+		waitForReply(dreq);
+		delete dreq;
+	}
+
+	void codec()
+	{
+		QRedis::Client cc;
+		cc.setCodec(new QRedis::LzfCodec, 1024);
+		cc.connectToServer("localhost", 6379);
+
+		QSignalSpy spy(&cc, SIGNAL(connected()));
+		waitForSignal(&spy);
+
+		QByteArray value;
+		for(int n = 0; value.size() < 20000; ++n)
+			value += "{\"id\":" + QByteArray::number(n) + ",\"name\":\"item\",\"tags\":[\"a\",\"b\"]},";
+
+		// plain value that looks like an encoded one
+		QByteArray tricky("\0QZ\1\0\0\0\5hello", 13);
+
+		QRedis::Request *req = cc.createRequest();
+		req->set("test-codec1", value);
+		waitForReply(req);
+		delete req;
+
+		req = cc.createRequest();
+		req->set("test-codec2", tricky);
+		waitForReply(req);
+		delete req;
+
+		req = cc.createRequest();
+		req->start("MGET", "test-codec1", "test-codec2");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toList().value(0).toByteArray(), value);
+		QCOMPARE(rep.value.toList().value(1).toByteArray(), tricky);
+
+		// stored compressed
+		req = client->createRequest();
+		req->start("STRLEN", "test-codec1");
+		rep = waitForReply(req);
+		delete req;
+		QVERIFY(rep.value.toInt() < value.size() / 2);
+
+		QRedis::CodecStats stats = cc.codecStats();
+		QCOMPARE(stats.encoded, (qint64)1);
+		QCOMPARE(stats.decoded, (qint64)1);
+		QVERIFY(stats.ratio() > 2);
+
+		// the old value returned by SET with GET is decoded too
+		req = cc.createRequest();
+		req->start("SET", "test-codec1", "small", "GET");
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), value);
+
+		// a size the data can't expand to is not decoded
+		QByteArray forged("\0QZ\1\x7f\xff\xff\xff\1ab", 11);
+		req = client->createRequest();
+		req->set("test-codec3", forged);
+		waitForReply(req);
+		delete req;
+
+		req = cc.createRequest();
+		req->get("test-codec3");
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), forged);
+
+		req = client->createRequest();
+		req->start("DEL", "test-codec1", "test-codec2", "test-codec3");
+		waitForReply(req);
+		delete req;
+	}
+
+	void transaction()
+	{
+		QRedis::Transaction *t = client->createTransaction();
+		t->add(QList<QByteArray>() << "SET" << "test-tx1" << "a");
+		t->add(QList<QByteArray>() << "INCR" << "test-tx2");
+		t->add(QList<QByteArray>() << "GET" << "test-tx1");
+		t->add(QList<QByteArray>() << "LPUSH" << "test-tx1" << "x");
+		QSignalSpy spy(t, SIGNAL(readyRead(const QList<QRedis::Reply> &)));
+		t->exec();
+		waitForSignal(&spy);
+
+		QList<QRedis::Reply> replies = spy.takeFirst().first().value<QList<QRedis::Reply> >();
+		QCOMPARE(replies.count(), 4);
+		QCOMPARE(replies[0].value.toByteArray(), QByteArray("OK"));
+		QVERIFY(!replies[0].error);
+		QCOMPARE(replies[1].value.toInt(), 1);
+		QCOMPARE(replies[2].value.toByteArray(), QByteArray("a"));
+
+		// the failed command is reported on its own
+		QVERIFY(replies[3].error);
+		QVERIFY(replies[3].value.toByteArray().startsWith("WRONGTYPE"));
+		delete t;
+
+		// a watched key modified before EXEC aborts the transaction
+		t = client->createTransaction();
+		QSignalSpy watchedSpy(t, SIGNAL(watched()));
+		t->watch(QList<QByteArray>() << "test-tx1");
+		waitForSignal(&watchedSpy);
+
+		// another transaction's EXEC on the client doesn't clear the watch
+		QRedis::Transaction *t2 = client->createTransaction();
+		t2->add(QList<QByteArray>() << "INCR" << "test-tx2");
+		QSignalSpy t2Spy(t2, SIGNAL(readyRead(const QList<QRedis::Reply> &)));
+		t2->exec();
+		waitForSignal(&t2Spy);
+		delete t2;
+
+		QRedis::Client other;
+		other.connectToServer("localhost", 6379);
+		QSignalSpy connectedSpy(&other, SIGNAL(connected()));
+		waitForSignal(&connectedSpy);
+
+		QRedis::Request *req = other.createRequest();
+		req->set("test-tx1", "b");
+		waitForReply(req);
+		delete req;
+
+		t->add(QList<QByteArray>() << "SET" << "test-tx1" << "c");
+		QSignalSpy abortedSpy(t, SIGNAL(aborted()));
+		t->exec();
+		waitForSignal(&abortedSpy);
+		delete t;
+
+		req = client->createRequest();
+		req->get("test-tx1");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("b"));
+
+		req = client->createRequest();
+		req->start("DEL", "test-tx1", "test-tx2");
+		waitForReply(req);
+		delete req;
+	}
+
+	void recorder()
+	{
+		QRedis::Client c;
+		QVERIFY(c.startRecording("test-record.log"));
+		c.connectToServer("localhost", 6379);
+
+		QRedis::Request *req = c.createRequest();
+		req->set("test-record1", "hello");
+		waitForReply(req);
+		delete req;
+
+		req = c.createRequest();
+		req->get("test-record1");
+		waitForReply(req);
+		delete req;
+
+		req = c.createRequest();
+		req->del("test-record1");
+		waitForReply(req);
+		delete req;
+
+		// taken back before it was written, so not logged
+		req = c.createRequest();
+		req->get("test-record1");
+		delete req;
+
+		QRedis::Transaction *t = c.createTransaction();
+		t->add(QList<QByteArray>() << "GET" << "test-record1");
+		QSignalSpy spy(t, SIGNAL(readyRead(const QList<QRedis::Reply> &)));
+		t->exec();
+		waitForSignal(&spy);
+		delete t;
+
+		c.stopRecording();
+
+		QFile file("test-record.log");
+		QVERIFY(file.open(QIODevice::ReadOnly));
+		QByteArray data = file.readAll();
+		file.close();
+		QFile::remove("test-record.log");
+
+		QRedis::RecordReader reader(data.constData(), data.size());
+		QVERIFY(reader.isValid());
+
+		QList<QRedis::RecordEntry> entries;
+		QRedis::RecordEntry e;
+		while(reader.next(&e))
+			entries += e;
+
+		QCOMPARE(entries.count(), 12);
+		QCOMPARE(entries[0].type, QRedis::RecordEntry::Command);
+		QCOMPARE(entries[0].args, QList<QByteArray>() << "SET" << "test-record1" << "hello");
+		QCOMPARE(entries[2].args, QList<QByteArray>() << "GET" << "test-record1");
+		QCOMPARE(entries[3].type, QRedis::RecordEntry::Reply);
+		QCOMPARE(entries[3].id, entries[2].id);
+		QCOMPARE(entries[3].size, (quint64)5);
+		QVERIFY(entries[4].usecs >= entries[2].usecs);
+		QCOMPARE(entries[6].args, QList<QByteArray>() << "MULTI");
+		QCOMPARE(entries[8].args, QList<QByteArray>() << "EXEC");
+		QCOMPARE(entries[11].type, QRedis::RecordEntry::Reply);
+		QCOMPARE(entries[11].id, entries[8].id);
+	}
+
+	void bulkLoader()
+	{
+		QByteArray data;
+		QList<QByteArray> keys;
+		for(int n = 0; n < 10000; ++n)
+		{
+			keys += "test-load" + QByteArray::number(n);
+			data += "SET\t" + keys.last() + "\t" + QByteArray::number(n) + "\n";
+		}
+		data += "NOSUCHCOMMAND\tx\n";
+
+		QBuffer in(&data);
+		in.open(QIODevice::ReadOnly);
+
+		QRedis::BulkLoader loader(client);
+		loader.setWindow(1000);
+		QSignalSpy finishedSpy(&loader, SIGNAL(finished()));
+		loader.start(&in);
+		waitForSignal(&finishedSpy);
+
+		QCOMPARE(loader.sentCount(), (qint64)10001);
+		QCOMPARE(loader.replyCount(), (qint64)10001);
+		QCOMPARE(loader.errorCount(), (qint64)1);
+		QVERIFY(loader.lastError().startsWith("ERR"));
+
+		QRedis::Request *req = client->createRequest();
+		req->get("test-load9999");
+		QRedis::Reply rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toByteArray(), QByteArray("9999"));
+
+		finishedSpy.clear();
+		CounterSource source(5000);
+		loader.start(&source);
+		waitForSignal(&finishedSpy);
+		QCOMPARE(loader.errorCount(), (qint64)0);
+
+		req = client->createRequest();
+		req->start("LLEN", "test-load-list");
+		rep = waitForReply(req);
+		delete req;
+		QCOMPARE(rep.value.toInt(), 5000);
+
+		keys += "test-load-list";
+		QRedis::BulkRequest *breq = client->createBulkRequest();
+		breq->del(keys);
+		waitForReply(breq);
+		delete breq;
+	}
+
+	void keySampler()
+	{
+		QRedis::Client c;
+		c.setKeySampling(1);
+		c.setKeyReportInterval(60000);
+		c.connectToServer("localhost", 6379);
+
+		QRedis::Request *req = c.createRequest();
+		req->set("test-sample-big", QByteArray(100000, 'x'));
+		waitForReply(req);
+		delete req;
+
+		QList<QRedis::Request*> reqs;
+		for(int n = 0; n < 200; ++n)
+		{
+			req = c.createRequest();
+			req->get("test-sample-hot");
+			reqs += req;
+		}
+		for(int n = 0; n < 100; ++n)
+		{
+			req = c.createRequest();
+			req->get("test-sample-cold" + QByteArray::number(n));
+			reqs += req;
+		}
+		req = c.createRequest();
+		req->get("test-sample-big");
+		reqs += req;
+
+		waitForReply(reqs.last());
+		qDeleteAll(reqs);
+
+		QList<QRedis::HotKey> hot = c.hotKeys();
+		QVERIFY(!hot.isEmpty());
+		QCOMPARE(hot[0].key, QByteArray("test-sample-hot"));
+		QVERIFY(hot[0].count >= 200);
+
+		QList<QRedis::BigKey> big = c.bigKeys();
+		QVERIFY(!big.isEmpty());
+		QCOMPARE(big[0].key, QByteArray("test-sample-big"));
+		QCOMPARE(big[0].command, QByteArray("GET"));
+		QCOMPARE(big[0].size, (qint64)100000);
+
+		// counts fade after each report
+		c.setKeyReportInterval(10);
+		QSignalSpy spy(&c, SIGNAL(keyStatsReady()));
+		waitForSignal(&spy);
+		QVERIFY(c.hotKeys()[0].count < 200);
+
+		req = client->createRequest();
+		req->del("test-sample-big");
+		waitForReply(req);
+		delete req;
+	}
 };
 
 QTEST_MAIN(RedisTest)
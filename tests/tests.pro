@@ -1,4 +1,6 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
-	pro/redistest
+	pro/redistest \
+	pro/patterntest \
+	pro/faketest
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+#include "qredisclient.h"
+#include "qredisrequest.h"
+#include "qredisreply.h"
+#include "qredisrecorder.h"
+
+static void usage()
+{
+	fprintf(stderr, "usage: qredis-replay [options] <logfile>\n\n");
+	fprintf(stderr, "  --host <host>     server to replay against. default localhost\n");
+	fprintf(stderr, "  --port <port>     default 6379\n");
+	fprintf(stderr, "  --speed <factor>  multiple of the recorded rate. default 1\n");
+	fprintf(stderr, "  --max             send as fast as the window allows\n");
+	fprintf(stderr, "  --window <count>  commands in flight at most. default 1000\n");
+}
+
+// value at the given fraction of a sorted list
+static qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+	if(sorted.isEmpty())
+		return 0;
+
+	int at = qMin((int)(p * sorted.count()), sorted.count() - 1);
+	return sorted[at];
+}
+
+class App : public QObject
+{
+	Q_OBJECT
+
+public:
+	QString host;
+	int port;
+	double speed; // 0 for maximum
+	int window;
+	QString fileName;
+
+private:
+	QFile *file;
+	QRedis::RecordReader *reader;
+	QRedis::Client *client;
+	QTimer *timer;
+	QElapsedTimer time;
+	bool haveNext;
+	QRedis::RecordEntry next;
+	QHash<QRedis::Request*, qint64> inFlight; // request -> usecs sent
+	QVector<qint64> latencies;
+	QVector<qint64> recordedLatencies;
+	int skipped;
+	int errors;
+
+public:
+	App() :
+		port(6379),
+		speed(1),
+		window(1000),
+		file(0),
+		reader(0),
+		client(0),
+		haveNext(false),
+		skipped(0),
+		errors(0)
+	{
+		timer = new QTimer(this);
+		connect(timer, SIGNAL(timeout()), SLOT(pump()));
+		timer->setSingleShot(true);
+	}
+
+	~App()
+	{
+		qDeleteAll(inFlight.keys());
+		delete reader;
+		delete file;
+	}
+
+signals:
+	void quit();
+
+public slots:
+	void start()
+	{
+		file = new QFile(fileName);
+		if(!file->open(QIODevice::ReadOnly))
+		{
+			fprintf(stderr, "error: can't open %s\n", qPrintable(fileName));
+			emit quit();
+			return;
+		}
+
+		// the log is read through a mapping, so it is never copied in full
+		uchar *data = file->map(0, file->size());
+		if(!data)
+		{
+			fprintf(stderr, "error: can't map %s\n", qPrintable(fileName));
+			emit quit();
+			return;
+		}
+
+		reader = new QRedis::RecordReader((const char *)data, file->size());
+		if(!reader->isValid())
+		{
+			fprintf(stderr, "error: %s is not a command log\n", qPrintable(fileName));
+			emit quit();
+			return;
+		}
+
+		client = new QRedis::Client(this);
+		connect(client, SIGNAL(connected()), SLOT(client_connected()));
+		client->connectToServer(host, port);
+	}
+
+private:
+	// reads up to the next command, collecting recorded latencies on the
+	//   way. returns false at the end of the log
+	bool readNext()
+	{
+		QRedis::RecordEntry e;
+		while(reader->next(&e))
+		{
+			if(e.type == QRedis::RecordEntry::Reply)
+			{
+				recordedLatencies += e.latency;
+				continue;
+			}
+			else if(e.type != QRedis::RecordEntry::Command || e.args.isEmpty())
+				continue;
+
+			// subscriptions never finish, so they can't be replayed
+			QByteArray name = e.args[0].toUpper();
+			if(name.endsWith("SUBSCRIBE"))
+			{
+				++skipped;
+				continue;
+			}
+
+			next = e;
+			return true;
+		}
+
+		return false;
+	}
+
+	void finish()
+	{
+		double secs = time.nsecsElapsed() / 1000000000.0;
+
+		qSort(latencies);
+		qSort(recordedLatencies);
+
+		printf("commands:    %d (%d errors, %d skipped)\n", latencies.count(), errors, skipped);
+		printf("elapsed:     %.3f s\n", secs);
+		printf("throughput:  %.0f ops/s\n", secs > 0 ? latencies.count() / secs : 0.0);
+		printf("latency us:  p50 %lld  p90 %lld  p99 %lld  max %lld\n",
+			percentile(latencies, 0.5), percentile(latencies, 0.9),
+			percentile(latencies, 0.99), percentile(latencies, 1));
+		printf("recorded us: p50 %lld  p90 %lld  p99 %lld  max %lld\n",
+			percentile(recordedLatencies, 0.5), percentile(recordedLatencies, 0.9),
+			percentile(recordedLatencies, 0.99), percentile(recordedLatencies, 1));
+
+		emit quit();
+	}
+
+	void handleDone(QRedis::Request *req)
+	{
+		qint64 sentAt = inFlight.take(req);
+		latencies += time.nsecsElapsed() / 1000 - sentAt;
+		delete req;
+
+		pump();
+	}
+
+private slots:
+	void client_connected()
+	{
+		// only the first connect starts the replay
+		disconnect(client, SIGNAL(connected()), this, SLOT(client_connected()));
+
+		time.start();
+		haveNext = readNext();
+		pump();
+	}
+
+	void pump()
+	{
+		while(haveNext && inFlight.count() < window)
+		{
+			qint64 now = time.nsecsElapsed() / 1000;
+
+			if(speed > 0)
+			{
+				qint64 due = (qint64)(next.usecs / speed);
+				if(due > now)
+				{
+					if(!timer->isActive())
+						timer->start(qMax((int)((due - now) / 1000), 1));
+					return;
+				}
+			}
+
+			QRedis::Request *req = client->createRequest();
+			connect(req, SIGNAL(readyRead(const QRedis::Reply &)), SLOT(req_readyRead(const QRedis::Reply &)));
+			connect(req, SIGNAL(error()), SLOT(req_error()));
+			inFlight.insert(req, now);
+			req->start(next.args);
+
+			haveNext = readNext();
+		}
+
+		if(!haveNext && inFlight.isEmpty())
+			finish();
+	}
+
+	void req_readyRead(const QRedis::Reply &reply)
+	{
+		Q_UNUSED(reply);
+
+		handleDone((QRedis::Request *)sender());
+	}
+
+	void req_error()
+	{
+		++errors;
+		handleDone((QRedis::Request *)sender());
+	}
+};
+
+int main(int argc, char **argv)
+{
+	QCoreApplication qapp(argc, argv);
+
+	App app;
+	app.host = "localhost";
+
+	QStringList args = qapp.arguments();
+	for(int n = 1; n < args.count(); ++n)
+	{
+		const QString &arg = args[n];
+		if(arg == "--max")
+			app.speed = 0;
+		else if((arg == "--host" || arg == "--port" || arg == "--speed" || arg == "--window") && n + 1 < args.count())
+		{
+			QString val = args[++n];
+			if(arg == "--host")
+				app.host = val;
+			else if(arg == "--port")
+				app.port = val.toInt();
+			else if(arg == "--speed")
+				app.speed = val.toDouble();
+			else // --window
+				app.window = qMax(val.toInt(), 1);
+		}
+		else if(!arg.startsWith("--") && app.fileName.isEmpty())
+			app.fileName = arg;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if(app.fileName.isEmpty() || app.speed < 0)
+	{
+		usage();
+		return 1;
+	}
+
+	QObject::connect(&app, SIGNAL(quit()), &qapp, SLOT(quit()));
+	QTimer::singleShot(0, &app, SLOT(start()));
+	return qapp.exec();
+}
+
+#include "qredis-replay.moc"
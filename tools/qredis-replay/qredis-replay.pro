@@ -0,0 +1,6 @@
+include(../tools.pri)
+
+MOC_DIR = $$OUT_PWD/_moc
+OBJECTS_DIR = $$OUT_PWD/_obj
+
+SOURCES += qredis-replay.cpp
@@ -0,0 +1,11 @@
+QT -= gui
+QT += network
+
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../src
+LIBS += -L$$PWD/../src -lqredis
+PRE_TARGETDEPS += $$PWD/../src/libqredis.a
+
+exists($$PWD/../conf.pri):include($$PWD/../conf.pri)